@@ -5,6 +5,8 @@
 #include "llm.h"
 #include "genfile.h"
 #include "code_interpreter.h"
+#include "prompt_template.h"
+
 
 class ToolRegistry;
 
@@ -27,19 +29,72 @@ public:
     int nlop;
     double nlops;
     long long total_time;
-    json usage;
+    json usage = json::object();
     int toks;
+    /// Completions with and without provider-cached prompt tokens, time in us
+    struct prefix_cache_stats {
+        int hit_calls{0};
+        long long hit_time{0};
+        int miss_calls{0};
+        long long miss_time{0};
+    } prefix_cache;
+    /// Called between NLOPs with the executor that stepped, its count so far
+    /// and its next instruction; returning false ends the run there. Forked
+    /// executors call it too, from their own threads, passing themselves
+    using step_hook = std::function<bool(const AgentExecutor& executor, int nlop, const std::string& instruction)>;
 
 private:
     ///
     ///friend class ToolRegistry;
     std::unique_ptr<ToolRegistry> tools;
-    ///
-    std::string agent_executor_instruction;
+    /// Central executive instructions, the system prompt of every NLOP
+    PromptTemplate agent_executor_instruction;
+    /// What update_state needs of an instruction, built the first time it
+    /// runs with all the instructions it uses described
+    struct compiled_instruction {
+        std::string instructions;   /// Schemas of the used instructions
+        std::string few_shot;       /// Call examples for them
+    };
+    /// Shared with forks, never changed once built
+    std::unordered_map<std::string, std::shared_ptr<const compiled_instruction>> compiled_instructions;
+    /// Compiled instruction the system prompt currently shows
+    std::shared_ptr<const compiled_instruction> active_instruction;
+    /// Short term memory as last dumped, redumped only when it changes
+    json dumped_memory;
+    std::string dumped_memory_text;
     /// Loaded native instructions
     json native_instructions;
     /// Loaded agent instructions
     json agent_instructions;
+    /// Prompts as they were before render_instructions filled them;
+    /// descriptions come from these, so they hold nothing of one input
+    std::map<std::string, std::string> template_prompts;
+    /// Descriptions being generated, keyed by instruction name
+    std::map<std::string, std::future<std::string>> pending_descriptions;
+    /// Threads generating descriptions, bounds the concurrent calls
+    static constexpr size_t description_workers = 8;
+    int description_word_limit{10};
+    /// Keep the system prompt byte-stable and send volatile state last
+    bool stable_prompt_prefix{false};
+    /// Prompt token limit, oldest messages are dropped past it (0 disables)
+    size_t max_context_tokens{0};
+    /// Fan-out branches running at once across this executor and its forks,
+    /// nested fan-outs included; calls past the limit run in order inline
+    size_t max_branches{8};
+    std::shared_ptr<std::atomic<size_t>> running_branches{std::make_shared<std::atomic<size_t>>(0)};
+    /// Yield point between NLOPs
+    step_hook on_step;
+    /// Set from any thread, the run ends before its next NLOP. Cleared only
+    /// when the executor is created; sessions and branches are fresh forks
+    std::atomic<bool> interrupted{false};
+    /// Cancels the LLM call in flight on interrupt, forks are cancelled with it
+    liboai::netimpl::components::CancelToken cancel{liboai::netimpl::components::CancelToken::Create()};
+    /// Forked executors run on the LLM of the executor that forked them
+    LLM* shared_llm{nullptr};
+    /// Spinner and console output; only one interactive executor per process
+    bool interactive{true};
+    /// Directory for files, commands and the Python environment, empty for the current one
+    std::string workspace;
     /// Current active working memory
     std::shared_ptr<liboai::Conversation> working_memory;
     ///
@@ -64,18 +119,52 @@ public:
     ///
     void set_state_variable(const std::string& name, const std::string& value);
     bool init_native_tools(const std::string& file_path);
-    void init_agent(std::map<std::string, Instruction>& inst);
+    bool init_native_tools_json(json schemas);
+    void init_agent(std::map<std::string, Instruction>& inst, std::optional<json> descriptions = std::nullopt);
+    /// Fill template variables left in the instruction prompts
+    void render_instructions(const std::map<std::string, std::string>& variables);
+    const json& get_native_instructions() const { return native_instructions; }
+    const json& get_agent_instructions() const { return agent_instructions; }
+    bool has_instruction(const std::string& name) const { return instructions.contains(name); }
+    void describe_all_instructions();
+    void set_stable_prompt_prefix(bool enabled) { stable_prompt_prefix = enabled; }
+    void set_max_context_tokens(size_t tokens) { max_context_tokens = tokens; }
+    void set_max_branches(size_t branches) { max_branches = branches; }
+    void set_step_hook(step_hook hook) { on_step = std::move(hook); }
+    /// Runs after the hooks already set, the run continues while all return true
+    void add_step_hook(step_hook hook);
+    void interrupt() {
+        interrupted = true;
+        cancel.Cancel();
+    }
+    bool was_interrupted() const { return interrupted; }
+    void set_workspace(const std::string& directory);
+    const std::string& get_workspace() const { return workspace; }
+    /// Relative paths of tools resolve against the workspace
+    std::string workspace_path(const std::string& path) const;
+    void set_logger(Logger* session_logger) { logger = session_logger; }
+    Logger* get_logger() const { return logger; }
+    bool is_interactive() const { return interactive; }
+    std::shared_ptr<AgentExecutor> fork();
     std::string run_agent_thread(const std::string& entry_instruction, 
         const std::string& input, std::optional<liboai::Conversation> context = std::nullopt);
 
 private:
     void add_agent_instruction(const std::string& name, const std::string& description, 
         const std::string& input_prompt);
-    void prepare_agent_instructions(int word_count_limit);
+    std::string generate_description(const Instruction& instruction);
+    void describe_instructions(const std::vector<std::string>& names);
+    std::shared_ptr<const compiled_instruction> compile_instruction(const Instruction& instruction);
+    const std::string& short_term_memory_text();
     void update_state(const Instruction& instruction);
     void execute();
+    bool step();
     void apply_instruction_response(std::shared_ptr<liboai::Conversation> working_memory,
         const std::string& content, const std::string& name, const std::string& result);
     void stop(const std::string &content);
     void parse_content(std::string& content);
+    LLM& nlp() { return shared_llm ? *shared_llm : llm; }
+    std::vector<json> get_branch_calls(const std::vector<std::string>& json_blocks, const Instruction& current) const;
+    bool acquire_branch();
+    std::vector<std::string> fan_out(const std::vector<json>& calls);
 };
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "core.h"
+#include "logger.h"
+#include "agent_executor.h"
+
+#include <condition_variable>
+
+///
+/// @brief Many agent sessions in one process
+///
+/// Sessions are forks of a configured prototype executor, or of the agent
+/// given with the request, so they share its LLM (connection pool, rate
+/// budgets, caches), its agent and its Python environment. Each has its own
+/// state, working contexts, log and workspace directory. The session input
+/// also fills {{input}} left in the instruction prompts. A fixed set of
+/// worker threads runs the queued sessions; a session holds its worker
+/// until the agent returns. Interrupting the prototype ends every running
+/// session after its current NLOP.
+///
+class AgentRuntime {
+public:
+    struct session_result {
+        std::string id;
+        std::string output;
+        std::string error;          /// Empty on success
+        bool interrupted{false};
+        int nlop{0};
+        json usage = json::object();
+        AgentExecutor::prefix_cache_stats prefix_cache;
+        double time_ms{0};
+        std::string workspace;
+    };
+
+    /// Called on the worker thread as soon as a session ends
+    using completion_callback = std::function<void(const session_result&)>;
+    /// Called between NLOPs of a session, false ends it; on the worker
+    /// thread, or at once from the threads of a fan-out with each branch
+    using session_hook = AgentExecutor::step_hook;
+
+    struct session_request {
+        std::string entry{"root"};              /// Instruction to start from
+        std::string input;                      /// First user message
+        std::string id;                         /// Session id, also names the workspace after its sequence number
+        std::shared_ptr<AgentExecutor> agent;   /// Forked instead of the prototype when set
+        completion_callback on_done;            /// Runs before the future is ready
+        session_hook on_step;
+    };
+
+    struct stats {
+        uint64_t submitted{0};
+        uint64_t completed{0};
+        uint64_t failed{0};
+        size_t running{0};
+        size_t queued{0};
+    };
+
+private:
+    struct task {
+        uint64_t sequence;
+        session_request request;
+        std::promise<session_result> result;
+    };
+
+    std::shared_ptr<AgentExecutor> prototype;
+    std::string workspace_root;
+    std::vector<std::thread> workers;
+    std::deque<task> queue;
+    std::mutex mutex;
+    std::condition_variable queue_cv;
+    bool stopping{false};
+    uint64_t next_id{0};
+    stats counters;
+
+    /// Ids become directory names
+    static std::string sanitize(const std::string& id) {
+        std::string result = id;
+        for (char& c : result) {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') {
+                c = '_';
+            }
+        }
+        return result.empty() || result == "." || result == ".." ? "_" : result;
+    }
+
+    session_result run(task& item) {
+        const session_request& request = item.request;
+        session_result result;
+        result.id = request.id;
+        /// Numbered, ids given by callers may repeat
+        result.workspace = (std::filesystem::path(workspace_root) /
+            fmt::format("{:06}-{}", item.sequence, sanitize(request.id))).string();
+        auto start = std::chrono::steady_clock::now();
+        const auto& agent = request.agent ? request.agent : prototype;
+        if (prototype->was_interrupted() || agent->was_interrupted()) {
+            result.interrupted = true;
+            return result;
+        }
+        try {
+            std::filesystem::create_directories(result.workspace);
+            /// Declared first, the session logs until it is destroyed
+            Logger log((std::filesystem::path(result.workspace) / "logs").string());
+            auto session = agent->fork();
+            session->set_workspace(result.workspace);
+            session->code_interpreter.share_environment(agent->code_interpreter);
+            session->set_logger(&log);
+            session->render_instructions({{"input", request.input}});
+            if (request.on_step) {
+                session->add_step_hook(request.on_step);
+            }
+            result.output = session->run_agent_thread(request.entry, request.input);
+            result.interrupted = session->was_interrupted();
+            result.nlop = session->nlop;
+            result.usage = session->usage;
+            result.prefix_cache = session->prefix_cache;
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        } catch (const char* e) {
+            result.error = e;
+        }
+        result.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    void work() {
+        for (;;) {
+            task item;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queue_cv.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) {
+                    return; /// Stopping and everything has run
+                }
+                item = std::move(queue.front());
+                queue.pop_front();
+                counters.running++;
+            }
+            session_result result = run(item);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                counters.running--;
+                (result.error.empty() ? counters.completed : counters.failed)++;
+            }
+            if (item.request.on_done) {
+                item.request.on_done(result);
+            }
+            item.result.set_value(std::move(result));
+        }
+    }
+
+public:
+    /// @param prototype Executor with the agent and LLM set up, never run itself
+    /// @param threads Sessions running at once
+    /// @param workspace_root Parent directory of the session workspaces
+    AgentRuntime(std::shared_ptr<AgentExecutor> prototype, size_t threads, std::string workspace_root = "sessions")
+        : prototype(std::move(prototype)), workspace_root(std::move(workspace_root)) {
+        threads = std::max<size_t>(threads, 1);
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back(&AgentRuntime::work, this);
+        }
+    }
+
+    AgentRuntime(const AgentRuntime&) = delete;
+    AgentRuntime& operator=(const AgentRuntime&) = delete;
+
+    /// Runs the queued sessions to the end
+    ~AgentRuntime() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queue_cv.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    /// Queue a session
+    std::future<session_result> submit(session_request request) {
+        std::future<session_result> future;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (request.id.empty()) {
+                request.id = "session";
+            }
+            queue.push_back(task{next_id++, std::move(request), {}});
+            future = queue.back().result.get_future();
+            counters.submitted++;
+        }
+        queue_cv.notify_one();
+        return future;
+    }
+
+    /// Ends running sessions after their current NLOP and queued ones before their first
+    void interrupt() {
+        prototype->interrupt();
+    }
+
+    stats get_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats result = counters;
+        result.queued = queue.size();
+        return result;
+    }
+};
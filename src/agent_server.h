@@ -0,0 +1,493 @@
+#pragma once
+
+#include "core.h"
+#include "logger.h"
+#include "agent_executor.h"
+#include "agent_runtime.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <cstring>
+
+///
+/// @brief Agents served over a local HTTP API
+///
+/// One long-lived process keeps everything a run needs resident: the LLM
+/// (connection pool, rate budgets, caches), the tool schemas, the Python
+/// environment and every agent loaded so far with its generated
+/// descriptions. A request only forks a session, so it pays for no parsing,
+/// probing or environment setup.
+///
+///   GET  /health  200 once listening
+///   GET  /stats   sessions submitted, running and queued, agents loaded
+///   POST /run     {"agent": "x.gen", "input": "...", "id": "...", "entry": "root"}
+///
+/// /run answers with newline delimited JSON events as the session runs:
+/// "accepted", a "step" after each NLOP and a final "done" or "error".
+/// Closing the connection ends the session after its current NLOP. At most
+/// max_sessions run at once and max_queue wait, counting requests whose
+/// agent is still loading; beyond that /run answers 503 and the client
+/// retries later.
+///
+/// Agents run shell commands and Python, so the server only listens
+/// locally: on a Unix socket by default, or on host:port. Over TCP a web
+/// page in the developer's browser could reach it, so requests must name a
+/// loopback Host (against DNS rebinding) and /run must be sent as
+/// application/json (a cross-site form post cannot be). A configured token
+/// is required as "Authorization: Bearer <token>" on every request.
+///
+class AgentServer {
+public:
+    struct options {
+        std::string host{"127.0.0.1"};
+        int port{8080};
+        std::string socket{"mentals.sock"};    /// Unix socket path, empty to listen on host:port
+        std::string token;                      /// Required bearer token, none when empty
+        size_t max_sessions{8};
+        size_t max_queue{64};
+        std::string workspace{"sessions"};
+        size_t max_request_bytes{1 << 20};
+    };
+
+    /// Loads an agent file into a new executor forked from the base
+    using agent_loader = std::function<std::shared_ptr<AgentExecutor>(const std::string& agent_file)>;
+
+private:
+    struct http_request {
+        std::string method;
+        std::string path;
+        std::map<std::string, std::string> headers;     /// Names in lower case
+        std::string body;
+    };
+
+    /// A client has this long to send its request, and to take each write
+    static constexpr int receive_timeout_s = 10;
+    static constexpr int send_timeout_s = 30;
+
+    struct loaded_agent {
+        std::filesystem::file_time_type modified;
+        std::shared_future<std::shared_ptr<AgentExecutor>> agent;
+    };
+
+    std::shared_ptr<AgentExecutor> base;
+    agent_loader loader;
+    options config;
+    AgentRuntime runtime;
+    std::atomic<bool> stopping{false};
+    std::atomic<int> listen_fd{-1};
+    std::mutex agents_mutex;
+    std::map<std::string, loaded_agent> agents;
+    std::mutex connections_mutex;
+    std::condition_variable connections_cv;
+    size_t connections{0};
+    /// Every session's stream plus a few for /health and /stats
+    size_t max_connections;
+    /// /run requests holding a session slot, loading, queued or running
+    size_t admitted{0};
+
+    static bool send_all(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    /// A write to a socket the client just closed still succeeds, a peek sees the close
+    static bool peer_closed(int fd) {
+        char c;
+        return ::recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 0;
+    }
+
+    static bool send_response(int fd, int status, const std::string& reason, const json& body,
+        const std::string& extra_headers = "") {
+        std::string content = body.dump() + "\n";
+        return send_all(fd, fmt::format(
+            "HTTP/1.1 {} {}\r\nContent-Type: application/json\r\nContent-Length: {}\r\n{}Connection: close\r\n\r\n{}",
+            status, reason, content.size(), extra_headers, content));
+    }
+
+    /// Request line, headers and a body of Content-Length bytes
+    std::optional<http_request> read_request(int fd) {
+        std::string data;
+        size_t header_end = std::string::npos;
+        char buffer[4096];
+        while ((header_end = data.find("\r\n\r\n")) == std::string::npos) {
+            if (data.size() > 64 * 1024) {
+                return std::nullopt;
+            }
+            ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                return std::nullopt;
+            }
+            data.append(buffer, static_cast<size_t>(n));
+        }
+        http_request request;
+        std::istringstream head(data.substr(0, header_end));
+        std::string line;
+        std::getline(head, line);
+        std::istringstream request_line(line);
+        request_line >> request.method >> request.path;
+        while (std::getline(head, line)) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(" \t"));
+            value.erase(value.find_last_not_of(" \t\r") + 1);
+            request.headers[to_lower(line.substr(0, colon))] = value;
+        }
+        size_t content_length = request.headers.contains("content-length")
+            ? std::strtoull(request.headers["content-length"].c_str(), nullptr, 10) : 0;
+        if (content_length > config.max_request_bytes) {
+            return std::nullopt;
+        }
+        request.body = data.substr(header_end + 4);
+        while (request.body.size() < content_length) {
+            ssize_t n = ::recv(fd, buffer, std::min(sizeof(buffer), content_length - request.body.size()), 0);
+            if (n <= 0) {
+                return std::nullopt;
+            }
+            request.body.append(buffer, static_cast<size_t>(n));
+        }
+        request.body.resize(content_length);
+        return request;
+    }
+
+    /// Error response for a request the server must not act on, if any
+    std::optional<std::pair<int, std::string>> refuse(const http_request& request) const {
+        auto header = [&](const std::string& name) {
+            auto found = request.headers.find(name);
+            return found == request.headers.end() ? std::string() : found->second;
+        };
+        if (config.socket.empty()) {
+            std::string host = header("host");
+            /// Without the port, brackets kept for IPv6
+            size_t colon = host.rfind(':');
+            if (colon != std::string::npos && host.find(']', colon) == std::string::npos) {
+                host.resize(colon);
+            }
+            if (host != "127.0.0.1" && host != "localhost" && host != "[::1]") {
+                return std::make_pair(403, "Host must be a loopback address");
+            }
+        }
+        if (!config.token.empty() && header("authorization") != "Bearer " + config.token) {
+            return std::make_pair(401, "missing or wrong bearer token");
+        }
+        if (request.method == "POST" && !to_lower(header("content-type")).starts_with("application/json")) {
+            return std::make_pair(415, "Content-Type must be application/json");
+        }
+        return std::nullopt;
+    }
+
+    /// Loaded once per version of the file; requests for an agent being
+    /// loaded wait for that load instead of starting their own
+    std::shared_ptr<AgentExecutor> get_agent(const std::string& agent_file) {
+        auto modified = std::filesystem::last_write_time(agent_file);
+        std::promise<std::shared_ptr<AgentExecutor>> loading;
+        std::shared_future<std::shared_ptr<AgentExecutor>> agent;
+        {
+            std::lock_guard<std::mutex> lock(agents_mutex);
+            auto found = agents.find(agent_file);
+            if (found != agents.end() && found->second.modified == modified) {
+                agent = found->second.agent;
+            } else {
+                agents[agent_file] = loaded_agent{modified, loading.get_future().share()};
+            }
+        }
+        if (agent.valid()) {
+            return agent.get();
+        }
+        try {
+            auto loaded = loader(agent_file);
+            loading.set_value(loaded);
+            return loaded;
+        } catch (...) {
+            /// The next request tries again
+            loading.set_exception(std::current_exception());
+            std::lock_guard<std::mutex> lock(agents_mutex);
+            agents.erase(agent_file);
+            throw;
+        }
+    }
+
+    json stats() {
+        auto counters = runtime.get_stats();
+        json loaded = json::array();
+        {
+            std::lock_guard<std::mutex> lock(agents_mutex);
+            for (const auto& [file, agent] : agents) {
+                loaded.push_back(file);
+            }
+        }
+        return {
+            {"submitted", counters.submitted},
+            {"completed", counters.completed},
+            {"failed", counters.failed},
+            {"running", counters.running},
+            {"queued", counters.queued},
+            {"max_sessions", config.max_sessions},
+            {"max_queue", config.max_queue},
+            {"agents", loaded}
+        };
+    }
+
+    void run_session(int fd, const http_request& request) {
+        json body = json::parse(request.body, nullptr, false);
+        if (!body.is_object() || !body.contains("agent") || !body["agent"].is_string()) {
+            send_response(fd, 400, "Bad Request", {{"error", "expected {\"agent\": \"file.gen\", \"input\": \"...\"}"}});
+            return;
+        }
+        std::string agent_file = body["agent"].get<std::string>();
+        std::filesystem::path agent_path(agent_file);
+        bool outside = agent_path.is_absolute() ||
+            std::any_of(agent_path.begin(), agent_path.end(), [](const auto& part) { return part == ".."; });
+        if (outside || !std::filesystem::is_regular_file(agent_path)) {
+            send_response(fd, 404, "Not Found", {{"error", "no agent file '" + agent_file + "'"}});
+            return;
+        }
+        /// The slot is taken before the agent loads, so concurrent requests
+        /// cannot all pass the check, and is given back on every return
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            full = admitted >= config.max_sessions + config.max_queue;
+            if (!full) {
+                admitted++;
+            }
+        }
+        if (full) {
+            send_response(fd, 503, "Service Unavailable", {{"error", "too many queued sessions"}}, "Retry-After: 1\r\n");
+            return;
+        }
+        struct session_slot {
+            AgentServer* server;
+            ~session_slot() {
+                std::lock_guard<std::mutex> lock(server->connections_mutex);
+                server->admitted--;
+            }
+        } slot{this};
+        for (const char* field : {"entry", "input", "id"}) {
+            if (body.contains(field) && !body[field].is_string()) {
+                send_response(fd, 400, "Bad Request", {{"error", fmt::format("'{}' must be a string", field)}});
+                return;
+            }
+        }
+        std::shared_ptr<AgentExecutor> agent;
+        try {
+            agent = get_agent(agent_file);
+        } catch (const std::exception& e) {
+            send_response(fd, 500, "Internal Server Error", {{"error", std::string("failed to load agent: ") + e.what()}});
+            return;
+        } catch (const char* e) {
+            send_response(fd, 500, "Internal Server Error", {{"error", std::string("failed to load agent: ") + e}});
+            return;
+        }
+
+        AgentRuntime::session_request session;
+        session.agent = agent;
+        session.entry = body.value("entry", std::string("root"));
+        session.input = body.value("input", std::string());
+        session.id = body.value("id", std::string("session"));
+        if (!agent->has_instruction(session.entry)) {
+            send_response(fd, 404, "Not Found", {{"error", "no instruction '" + session.entry + "'"}});
+            return;
+        }
+
+        /// Events go out as they happen, so the body has no length. Branches
+        /// of a fan-out step at once, one line is written at a time
+        std::string id = session.id;
+        std::mutex write_mutex;
+        auto event = [fd, &id, &write_mutex](json data) {
+            data["id"] = id;
+            std::string line = data.dump() + "\n";
+            std::lock_guard<std::mutex> lock(write_mutex);
+            return send_all(fd, line);
+        };
+        if (!send_all(fd, "HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n") ||
+            !event({{"event", "accepted"}})) {
+            return;
+        }
+        /// A failed write means the client is gone and the session stops;
+        /// a step reports the executor that made it, session or branch
+        session.on_step = [fd, &event](const AgentExecutor& executor, int nlop, const std::string& instruction) {
+            if (peer_closed(fd)) {
+                return false;
+            }
+            const json& output = executor.agent_executor_state.contains("output")
+                ? executor.agent_executor_state["output"] : json();
+            return event({
+                {"event", "step"},
+                {"nlop", nlop},
+                {"instruction", instruction},
+                {"output", output.is_string() ? output : json("")}
+            });
+        };
+        AgentRuntime::session_result result = runtime.submit(std::move(session)).get();
+        json done = {
+            {"event", result.error.empty() ? "done" : "error"},
+            {"output", result.output},
+            {"interrupted", result.interrupted},
+            {"nlop", result.nlop},
+            {"usage", result.usage},
+            {"time_ms", result.time_ms},
+            {"workspace", result.workspace}
+        };
+        if (!result.error.empty()) {
+            done["error"] = result.error;
+        }
+        event(std::move(done));
+    }
+
+    void handle(int fd) {
+        /// Nothing a request does may end the server
+        try {
+            auto request = read_request(fd);
+            std::optional<std::pair<int, std::string>> refused;
+            if (!request) {
+                send_response(fd, 400, "Bad Request", {{"error", "malformed, oversized or too slow request"}});
+            } else if ((refused = refuse(*request))) {
+                static const std::map<int, std::string> reasons{
+                    {401, "Unauthorized"}, {403, "Forbidden"}, {415, "Unsupported Media Type"}
+                };
+                send_response(fd, refused->first, reasons.at(refused->first), {{"error", refused->second}},
+                    refused->first == 401 ? "WWW-Authenticate: Bearer\r\n" : "");
+            } else if (request->method == "GET" && request->path == "/health") {
+                send_response(fd, 200, "OK", {{"status", "ok"}});
+            } else if (request->method == "GET" && request->path == "/stats") {
+                send_response(fd, 200, "OK", stats());
+            } else if (request->method == "POST" && request->path == "/run") {
+                run_session(fd, *request);
+            } else {
+                send_response(fd, 404, "Not Found", {{"error", "unknown route " + request->method + " " + request->path}});
+            }
+        } catch (...) {
+            /// Lost if the response has started, the client then sees the stream end early
+            send_response(fd, 500, "Internal Server Error", {{"error", "internal error"}});
+        }
+        ::close(fd);
+    }
+
+    int open_listener() {
+        int fd = -1;
+        if (!config.socket.empty()) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (config.socket.size() >= sizeof(address.sun_path)) {
+                throw std::runtime_error("Socket path too long: " + config.socket);
+            }
+            std::strncpy(address.sun_path, config.socket.c_str(), sizeof(address.sun_path) - 1);
+            /// A stale socket from an earlier run is replaced, anything else is left alone
+            struct stat existing;
+            if (::lstat(config.socket.c_str(), &existing) == 0) {
+                if (!S_ISSOCK(existing.st_mode)) {
+                    throw std::runtime_error("Refusing to replace " + config.socket + ", it is not a socket");
+                }
+                ::unlink(config.socket.c_str());
+            }
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+                throw std::runtime_error("Failed to bind " + config.socket + ": " + std::strerror(errno));
+            }
+        } else {
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(static_cast<uint16_t>(config.port));
+            if (::inet_pton(AF_INET, config.host.c_str(), &address.sin_addr) != 1) {
+                throw std::runtime_error("Invalid listen address " + config.host);
+            }
+            fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            int reuse = 1;
+            if (fd >= 0) {
+                ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            }
+            if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+                throw std::runtime_error(fmt::format("Failed to bind {}:{}: {}", config.host, config.port, std::strerror(errno)));
+            }
+        }
+        if (::listen(fd, 128) < 0) {
+            throw std::runtime_error(std::string("Failed to listen: ") + std::strerror(errno));
+        }
+        return fd;
+    }
+
+public:
+    /// @param base Executor with the LLM and Python environment set up, agents are forked from it
+    /// @param loader Loads an agent file the first time it is requested and after it changes
+    AgentServer(std::shared_ptr<AgentExecutor> base, agent_loader loader, options config)
+        : base(base), loader(std::move(loader)), config(std::move(config)),
+          runtime(base, this->config.max_sessions, this->config.workspace),
+          max_connections(this->config.max_sessions + this->config.max_queue + 8) {}
+
+    AgentServer(const AgentServer&) = delete;
+    AgentServer& operator=(const AgentServer&) = delete;
+
+    /// Serves until stop(), then waits for the open connections
+    void run() {
+        int fd = open_listener();
+        listen_fd = fd;
+        std::string address = config.socket.empty() ? fmt::format("http://{}:{}", config.host, config.port) : config.socket;
+        fmt::print("{}Serving agents on {} ({} sessions, {} queued at most)\n{}",
+            GREEN, address, config.max_sessions, config.max_queue, RESET);
+        std::fflush(stdout);
+        Logger::get_instance()->log("Serving agents on " + address);
+        while (!stopping) {
+            int client = ::accept(fd, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;  /// Listener shut down
+            }
+            timeval receive_timeout{receive_timeout_s, 0};
+            timeval send_timeout{send_timeout_s, 0};
+            ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout, sizeof(receive_timeout));
+            ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+            {
+                std::lock_guard<std::mutex> lock(connections_mutex);
+                if (connections >= max_connections) {
+                    send_response(client, 503, "Service Unavailable", {{"error", "too many connections"}}, "Retry-After: 1\r\n");
+                    ::close(client);
+                    continue;
+                }
+                connections++;
+            }
+            std::thread([this, client] {
+                handle(client);
+                std::lock_guard<std::mutex> lock(connections_mutex);
+                if (--connections == 0) {
+                    connections_cv.notify_all();
+                }
+            }).detach();
+        }
+        ::close(fd);
+        if (!config.socket.empty()) {
+            ::unlink(config.socket.c_str());
+        }
+        std::unique_lock<std::mutex> lock(connections_mutex);
+        connections_cv.wait(lock, [this] { return connections == 0; });
+    }
+
+    /// Stops accepting, safe to call from a signal handler; running sessions
+    /// end with the base executor
+    void stop() {
+        stopping = true;
+        int fd = listen_fd;
+        if (fd >= 0) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    }
+};
@@ -1,20 +1,38 @@
 #include "code_interpreter.h"
 
 CodeInterpreter::CodeInterpreter() {
-    python_executable = find_python_executable();
-    env_name = "python_env";
+    /// Probed once per process, executors are created per session and branch
+    static const std::string found = find_python_executable();
+    python_executable = found;
+    set_workspace("");
+}
+
+void CodeInterpreter::set_workspace(const std::string& directory) {
+    workspace = directory;
+    env_name = (std::filesystem::path(directory) / "python_env").string();
 #ifdef _WIN32
     env_path = env_name + "\\Scripts";
 #else
     env_path = env_name + "/bin";
 #endif
+    owns_environment = true;
 }
 
 CodeInterpreter::~CodeInterpreter() {
     delete_virtual_environment();
 }
 
+void CodeInterpreter::share_environment(const CodeInterpreter& owner) {
+    env_name = owner.env_name;
+    env_path = owner.env_path;
+    owns_environment = false;
+}
+
 bool CodeInterpreter::create_virtual_environment() {
+    /// A shared environment is created by its owner
+    if (!owns_environment) {
+        return true;
+    }
     if (python_executable.empty()) {
         return false;
     }
@@ -28,6 +46,9 @@ bool CodeInterpreter::create_virtual_environment() {
 }
 
 void CodeInterpreter::delete_virtual_environment() {
+    if (!owns_environment || !std::filesystem::exists(env_name)) {
+        return;
+    }
     std::string command;
 #ifdef _WIN32
     command = "rmdir /s /q " + env_name;
@@ -44,13 +65,20 @@ std::string CodeInterpreter::run_python_code(const std::string& code, const std:
         return "Python executable not found.";
     }
     std::string error_message;
+    /// Workspaces get their environment on first use
+    if (!std::filesystem::exists(env_name) && owns_environment) {
+        create_virtual_environment();
+    }
     if (!dependencies.empty()) {
         error_message = install_dependencies(dependencies);
         if (!error_message.empty()) {
             return "Failed to install dependencies: " + error_message;
         }
     }
-    std::string temp_file_name = "temp_code.py";
+    /// Unique per run, interpreters sharing a workspace may run at once
+    static std::atomic<uint64_t> script_counter{0};
+    std::string temp_file_name = (std::filesystem::path(workspace) /
+        fmt::format("temp_code_{}.py", script_counter++)).string();
     std::ofstream out(temp_file_name);
     if (!out) {
         return "Failed to create temporary file.";
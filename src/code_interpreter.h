@@ -9,12 +9,18 @@ public:
     /// 
     bool create_virtual_environment();
     void delete_virtual_environment();
+    /// Environment and scripts live in this directory, empty for the current one
+    void set_workspace(const std::string& directory);
+    /// Run in the environment of another interpreter, which keeps ownership of it
+    void share_environment(const CodeInterpreter& owner);
     std::string run_python_code(const std::string& code, const std::string& dependencies = "");
 
 private:
+    std::string workspace;
     std::string env_name;
     std::string env_path;
     std::string python_executable;
+    bool owns_environment{true};
     ///
     std::string get_activate_command() const;
     std::string install_dependencies(const std::string& dependencies);
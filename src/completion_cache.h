@@ -0,0 +1,162 @@
+#pragma once
+
+#include "core.h"
+#include "liboai.h"
+
+///
+/// @brief On-disk cache of deterministic chat completions
+///
+/// Temperature-0 requests are keyed by a content hash of everything that
+/// shapes the answer (backend endpoint, model, temperature, stop sequences,
+/// stream mode and the serialized conversation) and the response body is
+/// stored as <key>.json. Hits refresh the file time, and once the directory
+/// grows past its size bound the least recently used entries are removed.
+///
+class CompletionCache {
+public:
+    struct stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t evictions{0};
+        uintmax_t bytes{0};         /// Current size on disk
+    };
+
+private:
+    std::mutex mutex;
+    std::filesystem::path directory;
+    uintmax_t max_bytes{0};
+    stats counters;
+
+    /// Called with mutex held
+    void evict_locked() {
+        if (!max_bytes || counters.bytes <= max_bytes) {
+            return;
+        }
+        std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> entries;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            if (entry.path().extension() == ".json") {
+                entries.emplace_back(entry.last_write_time(ec), entry.path());
+            }
+        }
+        std::sort(entries.begin(), entries.end());
+
+        /// Trim to 90% so the next few puts do not rescan
+        uintmax_t target = max_bytes / 10 * 9;
+        for (const auto& [time, path] : entries) {
+            if (counters.bytes <= target) {
+                break;
+            }
+            uintmax_t size = std::filesystem::file_size(path, ec);
+            if (!ec && std::filesystem::remove(path, ec)) {
+                counters.bytes -= std::min(counters.bytes, size);
+                counters.evictions++;
+            }
+        }
+    }
+
+public:
+    /// Empty directory disables the cache, 0 max_bytes leaves it unbounded
+    void configure(const std::string& new_directory, uintmax_t new_max_bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        directory = new_directory;
+        max_bytes = new_max_bytes;
+        counters.bytes = 0;
+        if (directory.empty()) {
+            return;
+        }
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            if (entry.path().extension() == ".json") {
+                counters.bytes += entry.file_size(ec);
+            }
+        }
+        evict_locked();
+    }
+
+    bool enabled() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !directory.empty();
+    }
+
+    static std::string key(const std::string& endpoint, const std::string& model, float temperature,
+        const std::vector<std::string>& stop, bool stream, const liboai::Conversation& conversation) {
+        fnv_hasher h;
+        h.update(endpoint);
+        h.update(model);
+        h.update(fmt::format("{}", temperature));
+        for (const auto& sequence : stop) {
+            h.update(sequence);
+        }
+        h.update(stream ? "stream" : "batch");
+        for (const auto& message : conversation.GetSerializedMessages()) {
+            h.update(*message);
+        }
+        return h.hex();
+    }
+
+    std::optional<liboai::Response> get(const std::string& key) {
+        std::filesystem::path path;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            path = directory / (key + ".json");
+        }
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.misses++;
+            return std::nullopt;
+        }
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        file.close();
+
+        try {
+            liboai::Response response("cache://" + key, std::move(content), "HTTP/1.1 200 OK", "OK", 200, 0.0, -1);
+            std::error_code ec;
+            std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.hits++;
+            return response;
+        } catch (const std::exception&) {
+            /// Truncated or foreign file, drop it and go to the network
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.misses++;
+            return std::nullopt;
+        }
+    }
+
+    void put(const std::string& key, const std::string& content) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (directory.empty() || content.empty()) {
+            return;
+        }
+        std::filesystem::path path = directory / (key + ".json");
+        std::filesystem::path temp = directory / fmt::format("{}.{}.tmp", key,
+            std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if (!file || !file.write(content.data(), static_cast<std::streamsize>(content.size()))) {
+                return;
+            }
+        }
+        /// Rename is atomic, readers never see a partial entry
+        std::error_code ec;
+        uintmax_t previous = std::filesystem::exists(path, ec) ? std::filesystem::file_size(path, ec) : 0;
+        std::filesystem::rename(temp, path, ec);
+        if (ec) {
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+        counters.bytes += content.size();
+        counters.bytes -= std::min(counters.bytes, previous);
+        evict_locked();
+    }
+
+    stats get_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+};
@@ -2,28 +2,58 @@
 
 
 void print_help() {
-    std::cout << "\nUsage: mentals <filename> [--input=value] [-d|--debug]\n"
+    std::cout << "\nUsage: mentals <filename> [--input=value] [--compile] [-d|--debug]\n"
+        << "       mentals <filename> --batch <in.jsonl> --out <out.jsonl> [--concurrency N]\n"
+        << "       mentals serve [-d|--debug]\n"
         << "Arguments:\n"
-        << "  <filename>    The name of the agent file (.gen) to run.\n"
-        << "  --input=value The input value for the agent.\n"
-        << "  -h, --help    Show this help message and exit.\n"
-        << "  -d, --debug   Output debug messages.\n\n";
-}
-
-std::string parse_input(int argc, char* argv[], std::string& input) {
+        << "  <filename>        The name of the agent file (.gen) to run.\n"
+        << "  --input=value     The input value for the agent.\n"
+        << "  --compile         Write the compiled agent (.genc) and exit.\n"
+        << "  --batch file      Run the agent once per line of a JSONL file.\n"
+        << "  --out file        JSONL file the batch results are written to.\n"
+        << "  --concurrency N   Batch runs in flight at once (default 4).\n"
+        << "  serve             Serve agents over HTTP, see [serve] in config.toml.\n"
+        << "  -h, --help        Show this help message and exit.\n"
+        << "  -d, --debug       Output debug messages.\n\n";
+}
+
+std::string parse_input(int argc, char* argv[], std::string& input, batch_options& batch) {
     if (argc == 1 || std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help") {
         print_help();
         exit(EXIT_SUCCESS);
     }
     std::string filename = argv[1];
+    /// Value of "--name value" or "--name=value"
+    auto option_value = [&](int& i, const std::string& arg, const std::string& name, std::string& value) {
+        if (arg == name && i + 1 < argc) {
+            value = argv[++i];
+            return true;
+        }
+        if (arg.starts_with(name + "=")) {
+            value = arg.substr(name.size() + 1);
+            return true;
+        }
+        return false;
+    };
+    std::string concurrency;
     for (int i = 2; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg.starts_with("--input=")) {
             input = arg.substr(8);
         } else if (arg == "-d" || arg == "--debug") {
             debug = true;
+        } else if (arg == "--compile") {
+            compile_only = true;
+        } else if (option_value(i, arg, "--concurrency", concurrency)) {
+            batch.concurrency = std::max(std::atoi(concurrency.c_str()), 1);
+        } else if (!option_value(i, arg, "--batch", batch.input_file)) {
+            option_value(i, arg, "--out", batch.output_file);
         }
     }
+    if (!batch.input_file.empty() && batch.output_file.empty()) {
+        std::cerr << RED << "--batch needs --out\n" << RESET;
+        exit(EXIT_FAILURE);
+    }
     return filename;
 }
 
@@ -46,6 +46,7 @@
 #define MAX_INTEGER std::numeric_limits<int>::max()
 
 extern bool debug;
+extern bool compile_only;
 extern std::atomic<bool> spinner_active;
 extern std::thread spinner_thread;
 extern std::string completion_text;
@@ -76,10 +77,39 @@ struct Instruction {
     std::vector<std::string> use;
     bool keep_context;
     int max_context;
+    bool cacheable{false};      /// Completions may be served from the semantic cache
+};
+
+/// Content hash for cache, trace and artifact keys: two FNV-1a lanes with
+/// different bases give a 128-bit key
+struct fnv_hasher {
+    uint64_t a{14695981039346656037ull};
+    uint64_t b{0x6c62272e07bb0142ull};
+
+    void update(std::string_view data) {
+        for (unsigned char c : data) {
+            a = (a ^ c) * 1099511628211ull;
+            b = (b ^ c) * 1099511628211ull;
+        }
+        /// Field separator, so "ab"+"c" and "a"+"bc" differ
+        a = (a ^ 0xff) * 1099511628211ull;
+        b = (b ^ 0xfe) * 1099511628211ull;
+    }
+
+    std::string hex() const {
+        return fmt::format("{:016x}{:016x}", a, b);
+    }
+};
+
+/// Batch mode: one agent run per line of a JSONL input file
+struct batch_options {
+    std::string input_file;         /// Empty runs the agent once
+    std::string output_file;
+    int concurrency{4};
 };
 
 void print_help();
-std::string parse_input(int argc, char* argv[], std::string& input);
+std::string parse_input(int argc, char* argv[], std::string& input, batch_options& batch);
 std::string get_current_date();
 std::string to_lower(const std::string &str);
 std::string trim(const std::string &str);
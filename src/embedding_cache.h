@@ -0,0 +1,303 @@
+#pragma once
+
+#include "core.h"
+
+#include <list>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+    embedding store format
+
+    <directory>/embeddings.bin
+    -----------------------
+    record      key (2 x u64), dimensions (u32), dimensions x float
+
+    Records are only appended, under an exclusive flock so processes
+    sharing the store never interleave. The file is memory-mapped and
+    indexed by key on open; a torn record at the tail (crash mid-write)
+    is cut off under the same lock. Records other processes appended are
+    indexed on the next append.
+*/
+
+///
+/// @brief Two-tier embedding cache
+///
+/// Embeddings are keyed by a hash of the model, the dimensions and the
+/// content. Recent vectors live in an in-memory LRU; every vector is also
+/// appended to a memory-mapped store on disk, so re-ingesting a corpus or
+/// repeating a query in a later run needs no embedding request.
+///
+class EmbeddingCache {
+public:
+    struct stats {
+        uint64_t memory_hits{0};
+        uint64_t disk_hits{0};
+        uint64_t misses{0};
+        size_t disk_entries{0};
+    };
+
+    struct key_type {
+        uint64_t a;
+        uint64_t b;
+        bool operator==(const key_type& other) const { return a == other.a && b == other.b; }
+    };
+
+private:
+    struct key_hash {
+        size_t operator()(const key_type& key) const { return static_cast<size_t>(key.a ^ (key.b * 31)); }
+    };
+
+    struct record_header {
+        key_type key;
+        uint32_t dimensions;
+    };
+
+    using lru_list = std::list<std::pair<key_type, std::vector<float>>>;
+
+    std::mutex mutex;
+
+    /// Memory tier
+    lru_list lru;
+    std::unordered_map<key_type, lru_list::iterator, key_hash> lru_index;
+    size_t max_entries{4096};
+
+    /// Disk tier
+    int fd{-1};
+    const uint8_t* mapped{nullptr};
+    size_t mapped_size{0};
+    size_t file_size{0};
+    std::unordered_map<key_type, size_t, key_hash> disk_index;     /// key -> record offset
+
+    stats counters;
+
+    /// Called with mutex held
+    void remember(const key_type& key, std::vector<float> embedding) {
+        auto it = lru_index.find(key);
+        if (it != lru_index.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            return;
+        }
+        lru.emplace_front(key, std::move(embedding));
+        lru_index[key] = lru.begin();
+        while (lru.size() > max_entries) {
+            lru_index.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+
+#ifndef _WIN32
+    /// Called with mutex held
+    void unmap() {
+        if (mapped) {
+            ::munmap(const_cast<uint8_t*>(mapped), mapped_size);
+            mapped = nullptr;
+            mapped_size = 0;
+        }
+    }
+
+    /// Called with mutex held; maps everything appended so far
+    bool remap() {
+        unmap();
+        if (file_size == 0) {
+            return false;
+        }
+        void* data = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        mapped = static_cast<const uint8_t*>(data);
+        mapped_size = file_size;
+        return true;
+    }
+
+    /// Called with mutex held
+    void close_store() {
+        unmap();
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        file_size = 0;
+        disk_index.clear();
+    }
+
+    /// Called with mutex held; indexes the whole mapped records from offset on, returns where they end
+    size_t index_records(size_t offset) {
+        while (offset + sizeof(record_header) <= mapped_size) {
+            record_header header;
+            std::memcpy(&header, mapped + offset, sizeof(header));
+            size_t length = sizeof(header) + static_cast<size_t>(header.dimensions) * sizeof(float);
+            if (offset + length > mapped_size) {
+                break;
+            }
+            disk_index[header.key] = offset;
+            offset += length;
+        }
+        return offset;
+    }
+
+    /// Called with mutex and file lock held; indexes the records and drops a torn tail
+    void index_store() {
+        size_t offset = index_records(0);
+        if (offset != file_size) {
+            if (::ftruncate(fd, static_cast<off_t>(offset)) == 0) {
+                file_size = offset;
+                remap();
+            }
+        }
+    }
+
+    /// Called with mutex and file lock held; picks up records appended by other processes
+    void catch_up() {
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) <= file_size) {
+            return;
+        }
+        size_t indexed = file_size;
+        file_size = static_cast<size_t>(st.st_size);
+        if (remap()) {
+            index_records(indexed);
+        }
+    }
+#endif
+
+public:
+    EmbeddingCache() = default;
+    EmbeddingCache(const EmbeddingCache&) = delete;
+    EmbeddingCache& operator=(const EmbeddingCache&) = delete;
+
+    ~EmbeddingCache() {
+#ifndef _WIN32
+        std::lock_guard<std::mutex> lock(mutex);
+        close_store();
+#endif
+    }
+
+    /// Opens the disk tier in directory (empty keeps the memory tier only)
+    void configure(const std::string& directory, size_t memory_entries) {
+        std::lock_guard<std::mutex> lock(mutex);
+        max_entries = std::max<size_t>(memory_entries, 1);
+        while (lru.size() > max_entries) {
+            lru_index.erase(lru.back().first);
+            lru.pop_back();
+        }
+#ifndef _WIN32
+        close_store();
+        if (directory.empty()) {
+            return;
+        }
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        std::string path = (std::filesystem::path(directory) / "embeddings.bin").string();
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            return;
+        }
+        /// Held so a tail another process is still writing is never taken for torn
+        if (::flock(fd, LOCK_EX) != 0) {
+            close_store();
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0) {
+            file_size = static_cast<size_t>(st.st_size);
+        }
+        if (remap()) {
+            index_store();
+        }
+        ::flock(fd, LOCK_UN);
+#endif
+    }
+
+    static key_type key(embedding_model model, std::string_view content) {
+        fnv_hasher h;
+        h.update(fmt::format("{}", model));
+        h.update(std::to_string(static_cast<int>(model)));
+        h.update(content);
+        return {h.a, h.b};
+    }
+
+    std::optional<vdb::vector> get(embedding_model model, std::string_view content) {
+        key_type k = key(model, content);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = lru_index.find(k);
+        if (it != lru_index.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            counters.memory_hits++;
+            return vdb::vector(it->second->second, model);
+        }
+#ifndef _WIN32
+        auto disk = disk_index.find(k);
+        if (disk != disk_index.end()) {
+            /// Records appended since the last mapping need a wider one
+            if (disk->second + sizeof(record_header) > mapped_size && !remap()) {
+                counters.misses++;
+                return std::nullopt;
+            }
+            record_header header;
+            std::memcpy(&header, mapped + disk->second, sizeof(header));
+            size_t end = disk->second + sizeof(header) + static_cast<size_t>(header.dimensions) * sizeof(float);
+            if ((end <= mapped_size || remap()) && header.dimensions == static_cast<uint32_t>(model)) {
+                std::vector<float> embedding(header.dimensions);
+                std::memcpy(embedding.data(), mapped + disk->second + sizeof(header), header.dimensions * sizeof(float));
+                counters.disk_hits++;
+                vdb::vector result(embedding, model);
+                remember(k, std::move(embedding));
+                return result;
+            }
+        }
+#endif
+        counters.misses++;
+        return std::nullopt;
+    }
+
+    void put(embedding_model model, std::string_view content, const std::vector<float>& embedding) {
+        key_type k = key(model, content);
+        std::lock_guard<std::mutex> lock(mutex);
+        remember(k, embedding);
+#ifndef _WIN32
+        if (fd < 0 || disk_index.count(k) || ::flock(fd, LOCK_EX) != 0) {
+            return;
+        }
+        catch_up();
+        if (disk_index.count(k)) {
+            ::flock(fd, LOCK_UN);   /// Another process stored it meanwhile
+            return;
+        }
+        record_header header;
+        std::memset(&header, 0, sizeof(header));
+        header.key = k;
+        header.dimensions = static_cast<uint32_t>(embedding.size());
+        std::vector<uint8_t> record(sizeof(header) + embedding.size() * sizeof(float));
+        std::memcpy(record.data(), &header, sizeof(header));
+        std::memcpy(record.data() + sizeof(header), embedding.data(), embedding.size() * sizeof(float));
+        ssize_t written = ::write(fd, record.data(), record.size());
+        if (written == static_cast<ssize_t>(record.size())) {
+            disk_index[k] = file_size;
+            file_size += record.size();
+        } else if (written > 0) {
+            /// A short write would leave the next record misaligned
+            if (::ftruncate(fd, static_cast<off_t>(file_size)) != 0) {
+                close_store();
+                return;
+            }
+        }
+        ::flock(fd, LOCK_UN);
+#endif
+    }
+
+    stats get_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats result = counters;
+        result.disk_entries = disk_index.size();
+        return result;
+    }
+};
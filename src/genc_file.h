@@ -0,0 +1,201 @@
+#pragma once
+
+#include "core.h"
+
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+    compiled agent file format
+
+    some_file.genc
+    -----------------------
+    header      "GENC", format version (u32), source key (u64)
+    payload     MessagePack object:
+                instructions    parsed instructions with rendered prompts
+                descriptions    generated instruction descriptions
+                native_tools    native tool schemas
+
+    The source key hashes everything the payload was built from (agent
+    file, native tools, model, backend kind and endpoint), a mismatch
+    means a rebuild.
+*/
+
+///
+/// @brief Compiled agent artifacts for fast startup
+///
+class GencFile {
+public:
+    struct artifact {
+        std::map<std::string, Instruction> instructions;
+        json descriptions;
+        json native_tools;
+    };
+
+private:
+    static constexpr char magic[4] = {'G', 'E', 'N', 'C'};
+    static constexpr uint32_t version = 3;
+
+    struct header {
+        char magic[4];
+        uint32_t version;
+        uint64_t source_key;
+    };
+
+    static json to_json(const Instruction& instruction) {
+        return {
+            {"label", instruction.label},
+            {"prompt", instruction.prompt},
+            {"input_prompt", instruction.input_prompt},
+            {"temp", instruction.temp},
+            {"use", instruction.use},
+            {"keep_context", instruction.keep_context},
+            {"max_context", instruction.max_context},
+            {"cacheable", instruction.cacheable}
+        };
+    }
+
+    static Instruction from_json(const json& object) {
+        return Instruction{
+            object.at("label").get<std::string>(),
+            object.at("prompt").get<std::string>(),
+            object.at("input_prompt").get<std::string>(),
+            object.at("temp").get<float>(),
+            object.at("use").get<std::vector<std::string>>(),
+            object.at("keep_context").get<bool>(),
+            object.at("max_context").get<int>(),
+            object.at("cacheable").get<bool>()
+        };
+    }
+
+    /// Decodes a mapped or loaded artifact, nullopt if stale or malformed
+    static std::optional<artifact> decode(const uint8_t* data, size_t size, uint64_t source_key) {
+        header head;
+        if (size < sizeof(head)) {
+            return std::nullopt;
+        }
+        std::memcpy(&head, data, sizeof(head));
+        if (std::memcmp(head.magic, magic, sizeof(magic)) != 0 ||
+            head.version != version || head.source_key != source_key) {
+            return std::nullopt;
+        }
+        json payload = json::from_msgpack(data + sizeof(head), data + size, true, false);
+        if (payload.is_discarded()) {
+            return std::nullopt;
+        }
+        artifact result;
+        for (const auto& object : payload.at("instructions")) {
+            Instruction instruction = from_json(object);
+            result.instructions.emplace(instruction.label, std::move(instruction));
+        }
+        result.descriptions = std::move(payload.at("descriptions"));
+        result.native_tools = std::move(payload.at("native_tools"));
+        return result;
+    }
+
+public:
+
+    /// @brief Compiled artifact path for an agent file
+    static std::string artifact_path(const std::string& filename) {
+        return filename + "c";
+    }
+
+    /// @brief Key of the sources an artifact is built from (first FNV-1a lane)
+    static uint64_t source_key(const std::vector<std::string>& sources) {
+        fnv_hasher h;
+        for (const auto& source : sources) {
+            h.update(source);
+        }
+        return h.a;
+    }
+
+    /// @brief Load a compiled artifact if it matches the sources
+    /// @param filename Path to the .genc file
+    /// @param source_key Key of the current sources
+    /// @return Artifact, or nullopt if missing or stale
+    static std::optional<artifact> load(const std::string& filename, uint64_t source_key) {
+        guard("GencFile::load")
+#ifndef _WIN32
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return std::nullopt;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            return std::nullopt;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            return std::nullopt;
+        }
+        /// Decoded straight from the mapping, no read buffer
+        std::optional<artifact> result;
+        try {
+            result = decode(static_cast<const uint8_t*>(data), size, source_key);
+        } catch (const json::exception&) {
+            result = std::nullopt;
+        }
+        ::munmap(data, size);
+        return result;
+#else
+        std::string content = read_file(filename);
+        try {
+            return decode(reinterpret_cast<const uint8_t*>(content.data()), content.size(), source_key);
+        } catch (const json::exception&) {
+            return std::nullopt;
+        }
+#endif
+        unguard()
+        return std::nullopt;
+    }
+
+    /// @brief Write a compiled artifact
+    /// @param filename Path to the .genc file
+    /// @param source_key Key of the sources the artifact was built from
+    /// @param compiled Artifact content
+    /// @return True on success
+    static bool save(const std::string& filename, uint64_t source_key, const artifact& compiled) {
+        guard("GencFile::save")
+        json instructions = json::array();
+        for (const auto& [label, instruction] : compiled.instructions) {
+            instructions.push_back(to_json(instruction));
+        }
+        json payload = {
+            {"instructions", std::move(instructions)},
+            {"descriptions", compiled.descriptions},
+            {"native_tools", compiled.native_tools}
+        };
+        header head{};
+        std::memcpy(head.magic, magic, sizeof(magic));
+        head.version = version;
+        head.source_key = source_key;
+
+        std::vector<uint8_t> data(sizeof(head));
+        std::memcpy(data.data(), &head, sizeof(head));
+        json::to_msgpack(payload, data);
+
+        /// Written aside and renamed, a running load never sees half a file
+        std::string temp = filename + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if (!file || !file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()))) {
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp, filename, ec);
+        return !ec;
+        unguard()
+        return false;
+    }
+
+};
@@ -162,6 +162,26 @@ private:
         return max_context;
     }
 
+    bool parse_directive_cacheable(std::string& text) {
+        std::istringstream input_stream(text);
+        std::ostringstream output_stream;
+        std::string line;
+        /// Default value
+        bool cacheable = false;
+        /// Regex to match "## cacheable:" followed by optional whitespace and "true" or "false"
+        std::regex cacheable_regex(R"(##\s*cacheable:\s*(true|false)\s*)");
+        while (std::getline(input_stream, line)) {
+            std::smatch match;
+            if (std::regex_match(line, match, cacheable_regex)) {
+                cacheable = match[1] == "true";
+            } else {
+                output_stream << line << "\n";
+            }
+        }
+        text = output_stream.str();
+        return cacheable;
+    }
+
     /// @brief Parse variable sections from gpt content
     /// @param gen_content 
     /// @return Parsed variables as a map array
@@ -210,6 +230,7 @@ private:
             auto use = parse_directive_use(prompt);
             bool keep_context = parse_directive_keep_context(prompt);
             int max_context = parse_directive_max_context(prompt);
+            bool cacheable = parse_directive_cacheable(prompt);
             ///
             instructions[label] = Instruction{
                 label,          /// Instruction label
@@ -218,7 +239,8 @@ private:
                 0.1,            /// Temp : float
                 use,            /// Use : array
                 keep_context,   /// Keep context : boolean
-                max_context     /// Message queue
+                max_context,    /// Message queue
+                cacheable       /// Semantic cache : boolean
             };
         }
         return instructions;
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "core.h"
+
+///
+/// @brief When to fire a duplicate of a slow request
+///
+/// Tracks the latency of recent requests in a ring buffer. A request that
+/// has not finished by the configured percentile of that window gets one
+/// hedge, as long as hedges stay under the given fraction of traffic.
+///
+class HedgePolicy {
+public:
+    struct stats {
+        uint64_t requests{0};
+        uint64_t hedged{0};
+        uint64_t hedge_wins{0};     /// Hedge answered before the original
+        double threshold_ms{0};     /// Current trigger, 0 if not armed
+    };
+
+private:
+    static constexpr size_t window_size = 128;
+    static constexpr size_t min_samples = 16;
+
+    std::mutex mutex;
+    std::array<double, window_size> latencies{};
+    size_t samples{0};
+    size_t next{0};
+
+    double percentile{0};           /// 0 disables hedging
+    double max_fraction{0.05};
+
+    stats counters;
+
+    /// Called with mutex held
+    double threshold_locked() const {
+        size_t n = std::min(samples, window_size);
+        if (percentile <= 0 || n < min_samples) {
+            return 0;
+        }
+        std::array<double, window_size> sorted = latencies;
+        size_t rank = std::min(n - 1, static_cast<size_t>(percentile / 100.0 * n));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + n);
+        return sorted[rank];
+    }
+
+public:
+    void configure(double new_percentile, double new_max_fraction) {
+        std::lock_guard<std::mutex> lock(mutex);
+        percentile = std::clamp(new_percentile, 0.0, 100.0);
+        max_fraction = std::clamp(new_max_fraction, 0.0, 1.0);
+    }
+
+    bool enabled() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return percentile > 0;
+    }
+
+    /// Delay after which a request may be hedged, nullopt while not armed
+    std::optional<std::chrono::milliseconds> threshold() {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.requests++;
+        double ms = threshold_locked();
+        if (ms <= 0) {
+            return std::nullopt;
+        }
+        return std::chrono::milliseconds(static_cast<long>(ms));
+    }
+
+    /// Takes a hedge from the budget if the cap allows one
+    bool try_hedge() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (counters.hedged + 1 > max_fraction * counters.requests) {
+            return false;
+        }
+        counters.hedged++;
+        return true;
+    }
+
+    void record(double latency_ms, bool hedge_won) {
+        std::lock_guard<std::mutex> lock(mutex);
+        latencies[next] = latency_ms;
+        next = (next + 1) % window_size;
+        samples++;
+        if (hedge_won) {
+            counters.hedge_wins++;
+        }
+    }
+
+    stats get_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats result = counters;
+        result.threshold_ms = threshold_locked();
+        return result;
+    }
+};
@@ -7,11 +7,17 @@ liboai::Conversation::Conversation() {
 
 liboai::Conversation::Conversation(const Conversation& other) {
 	this->_conversation = other._conversation;
+	this->_serialized = other._serialized;
+	this->_logged = other._logged;
 }
 
 liboai::Conversation::Conversation(Conversation&& old) noexcept {
 	this->_conversation = std::move(old._conversation);
+	this->_serialized = std::move(old._serialized);
+	this->_logged = old._logged;
 	old._conversation = nlohmann::json::object();
+	old._serialized.clear();
+	old._logged = 0;
 }
 
 liboai::Conversation::Conversation(std::string_view system_data) {
@@ -52,12 +58,18 @@ liboai::Conversation::Conversation(const std::vector<std::string>& user_data) {
 
 liboai::Conversation& liboai::Conversation::operator=(const Conversation& other) {
 	this->_conversation = other._conversation;
+	this->_serialized = other._serialized;
+	this->_logged = other._logged;
 	return *this;
 }
 
 liboai::Conversation& liboai::Conversation::operator=(Conversation&& old) noexcept {
 	this->_conversation = std::move(old._conversation);
+	this->_serialized = std::move(old._serialized);
+	this->_logged = old._logged;
 	old._conversation = nlohmann::json::object();
+	old._serialized.clear();
+	old._logged = 0;
 	return *this;
 }
 
@@ -83,6 +95,7 @@ bool liboai::Conversation::SetSystemData(std::string_view data) & noexcept(false
 		for (auto& message : this->_conversation["messages"].items()) {
 			if (message.value()["role"].get<std::string>() == "system") {
 				message.value()["content"] = data; // update system message
+				this->Invalidate(std::stoul(message.key()));
 				return false; // system already set
 			}
 		}
@@ -98,6 +111,8 @@ bool liboai::Conversation::PopSystemData() & noexcept(false) {
 		// if first message is system
 		if (this->_conversation["messages"][0]["role"].get<std::string>() == "system") {
 			this->_conversation["messages"].erase(0);
+			this->Invalidate(0);
+			this->Forget(0, 1);
 			return true; // system message popped successfully
 		}
 		return false; // first message is not system
@@ -114,6 +129,8 @@ bool liboai::Conversation::UpdateQueue(int max_length) & noexcept(false) {
 				this->_conversation["messages"].begin() + 1,
 				this->_conversation["messages"].begin() + delta
 			);
+			this->Invalidate(1);
+			this->Forget(1, delta - 1);
 			size = this->_conversation["messages"].size();
 			return true;
 		}
@@ -121,6 +138,23 @@ bool liboai::Conversation::UpdateQueue(int max_length) & noexcept(false) {
 	return false;
 }
 
+bool liboai::Conversation::PopOldestData(size_t count) & noexcept(false) {
+	auto& messages = this->_conversation["messages"];
+	if (messages.empty() || count == 0) {
+		return false;
+	}
+	// keep the system message and the latest message
+	size_t first = messages[0]["role"].get<std::string>() == "system" ? 1 : 0;
+	if (messages.size() < first + 2) {
+		return false;
+	}
+	count = std::min(count, messages.size() - first - 1);
+	messages.erase(messages.begin() + first, messages.begin() + first + count);
+	this->Invalidate(first);
+	this->Forget(first, count);
+	return true;
+}
+
 bool liboai::Conversation::AddAssistantData(std::string_view data) & noexcept(false) {
 	// if data provided is non-empty
 	if (!data.empty()) {
@@ -152,6 +186,8 @@ bool liboai::Conversation::PopUserData() & noexcept(false) {
 		// if last message is user message
 		if (this->_conversation["messages"].back()["role"].get<std::string>() == "user") {
 			this->_conversation["messages"].erase(this->_conversation["messages"].end() - 1);
+			this->Invalidate(this->_conversation["messages"].size());
+			this->Forget(this->_conversation["messages"].size(), 1);
 			return true; // user data popped successfully
 		}
 		return false; // last message is not user message
@@ -171,6 +207,8 @@ bool liboai::Conversation::RemoveUserData(const std::string_view data) & noexcep
 
 		// Erase the removed elements from the container
 		this->_conversation["messages"].erase(it, this->_conversation["messages"].end());
+		this->Invalidate(0);
+		this->_logged = 0; // removed from anywhere, log everything again
 	}
 
 	return true;
@@ -197,6 +235,8 @@ bool liboai::Conversation::PopLastResponse() & noexcept(false) {
 		// if last message is assistant message
 		if (this->_conversation["messages"].back()["role"].get<std::string>() == "assistant") {
 			this->_conversation["messages"].erase(this->_conversation["messages"].end() - 1);
+			this->Invalidate(this->_conversation["messages"].size());
+			this->Forget(this->_conversation["messages"].size(), 1);
 			return true; // assistant data popped successfully
 		}
 		return false; // last message is not assistant message
@@ -279,6 +319,63 @@ bool liboai::Conversation::Update(const Response& response) & noexcept(false) {
 	return this->Update(response.content);
 }
 
+bool liboai::Conversation::AppendStreamData(std::string_view data, std::string& delta, bool& completed) & noexcept(false) {
+	this->_stream_buffer.append(data);
+
+	bool appended = false;
+	size_t start = 0, end;
+	// only complete lines are consumed, the tail stays buffered
+	while ((end = this->_stream_buffer.find('\n', start)) != std::string::npos) {
+		std::string_view line(this->_stream_buffer.data() + start, end - start);
+		start = end + 1;
+
+		if (!line.empty() && line.back() == '\r') {
+			line.remove_suffix(1);
+		}
+		if (line.substr(0, 5) != "data:") {
+			continue; // blank separator, comment or other field
+		}
+		line.remove_prefix(5);
+		if (!line.empty() && line.front() == ' ') {
+			line.remove_prefix(1);
+		}
+
+		if (line == "[DONE]") {
+			completed = true;
+			continue;
+		}
+
+		nlohmann::json j = nlohmann::json::parse(line);
+		auto usage = j.find("usage");
+		if (usage != j.end() && usage->is_object()) {
+			this->_stream_usage = std::move(*usage);
+		}
+		if (!j.contains("choices") || j["choices"].empty()) {
+			continue; // e.g. trailing usage-only chunk
+		}
+
+		const nlohmann::json& d = j["choices"][0]["delta"];
+		if (!d.contains("content") || !d["content"].is_string()) {
+			continue; // role-only or finishing chunk
+		}
+
+		const std::string& content = d["content"].get_ref<const std::string&>();
+		delta += content;
+
+		// if last message is not an assistant message, start one
+		if (this->_conversation["messages"].empty() || this->_conversation["messages"].back()["role"].get<std::string>() != "assistant") {
+			this->_conversation["messages"].push_back({ { "role", "assistant" }, { "content", "" } });
+		}
+		this->_conversation["messages"].back()["content"].get_ref<std::string&>() += content;
+		this->Invalidate(this->_conversation["messages"].size() - 1);
+		this->_logged = std::min(this->_logged, this->_conversation["messages"].size() - 1);
+		appended = true;
+	}
+	this->_stream_buffer.erase(0, start);
+
+	return appended;
+}
+
 std::string liboai::Conversation::GetRawConversation() const & noexcept {
 	return this->_conversation.dump(4);
 }
@@ -287,6 +384,46 @@ const nlohmann::json& liboai::Conversation::GetJSON() const & noexcept {
 	return this->_conversation;
 }
 
+const nlohmann::json& liboai::Conversation::GetStreamUsage() const & noexcept {
+	return this->_stream_usage;
+}
+
+const std::vector<std::shared_ptr<const std::string>>& liboai::Conversation::GetSerializedMessages() const & noexcept(false) {
+	auto messages = this->_conversation.find("messages");
+	if (messages == this->_conversation.end() || !messages->is_array()) {
+		this->_serialized.clear();
+		return this->_serialized;
+	}
+
+	this->Invalidate(messages->size());
+	// only messages past the cached prefix need serializing
+	for (size_t i = this->_serialized.size(); i < messages->size(); ++i) {
+		this->_serialized.push_back(std::make_shared<const std::string>((*messages)[i].dump()));
+	}
+	return this->_serialized;
+}
+
+void liboai::Conversation::Invalidate(size_t from) const noexcept {
+	if (this->_serialized.size() > from) {
+		this->_serialized.resize(from);
+	}
+}
+
+size_t liboai::Conversation::MarkLogged(size_t count) const & noexcept {
+	size_t logged = std::min(this->_logged, count);
+	this->_logged = count;
+	return logged;
+}
+
+void liboai::Conversation::Forget(size_t first, size_t count) noexcept {
+	if (this->_logged >= first + count) {
+		this->_logged -= count; // logged messages after the gap moved up
+	}
+	else if (this->_logged > first) {
+		this->_logged = first;
+	}
+}
+
 void liboai::ChatCompletion::SetEndpoint(const std::string& endpoint) {
 	this->SetRoot(endpoint);
 }
@@ -298,6 +435,10 @@ liboai::Response liboai::ChatCompletion::create(const std::string& model, const
 	jcon.push_back("top_p", std::move(top_p));
 	jcon.push_back("n", std::move(n));
 	jcon.push_back("stream", stream);
+	if (stream) {
+		// ask for the final usage-only chunk, see GetStreamUsage()
+		jcon.push_back("stream_options", nlohmann::json{ { "include_usage", true } });
+	}
 	jcon.push_back("stop", std::move(stop));
 	jcon.push_back("max_tokens", std::move(max_tokens));
 	jcon.push_back("presence_penalty", std::move(presence_penalty));
@@ -305,14 +446,6 @@ liboai::Response liboai::ChatCompletion::create(const std::string& model, const
 	jcon.push_back("logit_bias", std::move(logit_bias));
 	jcon.push_back("user", std::move(user));
 
-	if (conversation.GetJSON().contains("messages")) {
-		jcon.push_back("messages", conversation.GetJSON()["messages"]);
-	}
-
-	if (conversation.GetJSON().contains("functions")) {
-		jcon.push_back("functions", conversation.GetJSON()["functions"]);
-	}
-
 	//Logger* logger = Logger::getInstance();
 	//logger->log("call chat_completion");
 	//logger->log(jcon.dump());
@@ -324,9 +457,7 @@ liboai::Response liboai::ChatCompletion::create(const std::string& model, const
 		//Method::HTTP_POST, this->groq_root_, "/chat/completions", "application/json",
 		Method::HTTP_POST, this->endpoint_root_, "/chat/completions", "application/json",
 		this->auth_.GetAuthorizationHeaders(),
-		netimpl::components::Body {
-			jcon.dump()
-		},
+		this->BuildRequestBody(jcon, conversation),
 		stream ? netimpl::components::WriteCallback{std::move(stream.value())} : netimpl::components::WriteCallback{},
 		this->auth_.GetProxies(),
 		this->auth_.GetProxyAuth(),
@@ -336,13 +467,17 @@ liboai::Response liboai::ChatCompletion::create(const std::string& model, const
 	return res;
 }
 
-liboai::FutureResponse liboai::ChatCompletion::create_async(const std::string& model, const Conversation& conversation, std::optional<float> temperature, std::optional<float> top_p, std::optional<uint16_t> n, std::optional<std::function<bool(std::string, intptr_t)>> stream, std::optional<std::vector<std::string>> stop, std::optional<uint16_t> max_tokens, std::optional<float> presence_penalty, std::optional<float> frequency_penalty, std::optional<std::unordered_map<std::string, int8_t>> logit_bias, std::optional<std::string> user) const& noexcept(false) {
+liboai::FutureResponse liboai::ChatCompletion::create_async(const std::string& model, const Conversation& conversation, std::optional<float> temperature, std::optional<float> top_p, std::optional<uint16_t> n, std::optional<std::function<bool(std::string, intptr_t)>> stream, std::optional<std::vector<std::string>> stop, std::optional<uint16_t> max_tokens, std::optional<float> presence_penalty, std::optional<float> frequency_penalty, std::optional<std::unordered_map<std::string, int8_t>> logit_bias, std::optional<std::string> user, netimpl::components::CancelToken cancel, netimpl::components::CompletionHook hook) const& noexcept(false) {
 	liboai::JsonConstructor jcon;
 	jcon.push_back("model", model);
 	jcon.push_back("temperature", std::move(temperature));
 	jcon.push_back("top_p", std::move(top_p));
 	jcon.push_back("n", std::move(n));
 	jcon.push_back("stream", stream);
+	if (stream) {
+		// ask for the final usage-only chunk, see GetStreamUsage()
+		jcon.push_back("stream_options", nlohmann::json{ { "include_usage", true } });
+	}
 	jcon.push_back("stop", std::move(stop));
 	jcon.push_back("max_tokens", std::move(max_tokens));
 	jcon.push_back("presence_penalty", std::move(presence_penalty));
@@ -350,28 +485,58 @@ liboai::FutureResponse liboai::ChatCompletion::create_async(const std::string& m
 	jcon.push_back("logit_bias", std::move(logit_bias));
 	jcon.push_back("user", std::move(user));
 
-	if (conversation.GetJSON().contains("messages")) {
-		jcon.push_back("messages", conversation.GetJSON()["messages"]);
-	}
+	return this->RequestAsync(
+		Method::HTTP_POST, this->endpoint_root_, "/chat/completions", "application/json",
+		this->auth_.GetAuthorizationHeaders(),
+		this->BuildRequestBody(jcon, conversation),
+		stream ? netimpl::components::WriteCallback{ std::move(stream.value()) } : netimpl::components::WriteCallback{},
+		this->auth_.GetProxies(),
+		this->auth_.GetProxyAuth(),
+		this->auth_.GetMaxTimeout(),
+		std::move(cancel),
+		std::move(hook)
+	);
+}
 
-	auto _fn = [this](
-		liboai::JsonConstructor&& jcon,
-		std::optional<std::function<bool(std::string, intptr_t)>>&& stream
-	) -> liboai::Response {
-		return this->Request(
-			Method::HTTP_POST, this->openai_root_, "/chat/completions", "application/json",
-			this->auth_.GetAuthorizationHeaders(),
-			netimpl::components::Body {
-				jcon.dump()
-			},
-			stream ? netimpl::components::WriteCallback{ std::move(stream.value()) } : netimpl::components::WriteCallback{},
-			this->auth_.GetProxies(),
-			this->auth_.GetProxyAuth(),
-			this->auth_.GetMaxTimeout()
-		);
+liboai::netimpl::components::SegmentedBody liboai::ChatCompletion::BuildRequestBody(const JsonConstructor& jcon, const Conversation& conversation) const {
+	static const auto comma = std::make_shared<const std::string>(",");
+	netimpl::components::SegmentedBody body;
+
+	// reopen the parameter object to append the conversation to it
+	std::string part = jcon.dump();
+	part.pop_back();
+	bool first_key = part.size() == 1;
+	auto key = [&part, &first_key](std::string_view name) {
+		part += first_key ? "\"" : ",\"";
+		part += name;
+		part += "\":";
+		first_key = false;
 	};
-		
-	return std::async(std::launch::async, _fn, std::move(jcon), std::move(stream));
+
+	const nlohmann::json& conv = conversation.GetJSON();
+	if (conv.contains("functions")) {
+		key("functions");
+		part += conv["functions"].dump();
+	}
+
+	if (conv.contains("messages")) {
+		key("messages");
+		part += '[';
+		body.Append(std::exchange(part, std::string{}));
+
+		const auto& messages = conversation.GetSerializedMessages();
+		for (size_t i = 0; i < messages.size(); ++i) {
+			if (i > 0) {
+				body.Append(comma);
+			}
+			body.Append(messages[i]);
+		}
+		part += ']';
+	}
+
+	part += '}';
+	body.Append(std::move(part));
+	return body;
 }
 
 std::ostream& liboai::operator<<(std::ostream& os, const Conversation& conv) {
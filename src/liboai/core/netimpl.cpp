@@ -1,7 +1,7 @@
 #include "../include/core/netimpl.h"
 
-liboai::netimpl::CurlHolder::CurlHolder() {
-	std::lock_guard<std::mutex> lock{ this->curl_easy_get_mutex_() };
+void liboai::netimpl::CurlHolder::CheckSSL() {
+	std::lock_guard<std::mutex> lock{ curl_easy_get_mutex_() };
 
 	if (!_flag) {
 		curl_version_info_data* data = curl_version_info(CURLVERSION_NOW);
@@ -26,6 +26,10 @@ liboai::netimpl::CurlHolder::CurlHolder() {
 			#endif
 		}
 	}
+}
+
+liboai::netimpl::CurlHolder::CurlHolder() {
+	CheckSSL();
 	
 	this->curl_ = curl_easy_init();
 	if (!this->curl_) {
@@ -36,13 +40,49 @@ liboai::netimpl::CurlHolder::CurlHolder() {
 		);
 	}
 
+	ErrorCheck(
+		ConnectionPool::Instance().Share(this->curl_),
+		"liboai::netimpl::CurlHolder::CurlHolder()"
+	);
+
 	#if defined(LIBOAI_DEBUG)
 		curl_easy_setopt(this->curl_, CURLOPT_VERBOSE, 1L);
 	#endif
 }
 
+liboai::netimpl::CurlHolder::CurlHolder(std::nullptr_t) {
+	CheckSSL();
+}
+
+void liboai::netimpl::CurlHolder::Checkout(const std::string& url) {
+	std::string key = ConnectionPool::KeyFromUrl(url);
+	if (this->curl_ && key == this->pool_key_) {
+		return;
+	}
+
+	// a handle held for another host goes back to its own pool
+	if (this->curl_ && !this->pool_key_.empty()) {
+		ConnectionPool::Instance().Checkin(this->pool_key_, this->curl_, std::move(this->buffers_));
+		this->curl_ = nullptr;
+	}
+
+	this->curl_ = ConnectionPool::Instance().Checkout(url, &this->buffers_);
+	this->pool_key_ = std::move(key);
+
+	#if defined(LIBOAI_DEBUG)
+		_liboai_dbg(
+			"[dbg] [@%s] Checked out handle 0x%p for %s.\n",
+			__func__, this->curl_, this->pool_key_.c_str()
+		);
+	#endif
+}
+
 liboai::netimpl::CurlHolder::~CurlHolder() {
-	if (this->curl_) {
+	if (this->curl_ && !this->pool_key_.empty()) {
+		ConnectionPool::Instance().Checkin(this->pool_key_, this->curl_, std::move(this->buffers_));
+		this->curl_ = nullptr;
+	}
+	else if (this->curl_) {
 		curl_easy_cleanup(this->curl_);
 		this->curl_ = nullptr;
 		
@@ -55,6 +95,161 @@ liboai::netimpl::CurlHolder::~CurlHolder() {
 	}
 }
 
+liboai::netimpl::ConnectionPool::ConnectionPool() {
+	this->share_ = curl_share_init();
+	if (!this->share_) {
+		return;
+	}
+
+	curl_share_setopt(this->share_, CURLSHOPT_LOCKFUNC, &ConnectionPool::LockShare);
+	curl_share_setopt(this->share_, CURLSHOPT_UNLOCKFUNC, &ConnectionPool::UnlockShare);
+	curl_share_setopt(this->share_, CURLSHOPT_USERDATA, this);
+	curl_share_setopt(this->share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(this->share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	// no CURL_LOCK_DATA_CONNECT: libcurl does not support a connection
+	// cache shared by transfers running on several threads at once. Each
+	// pooled handle keeps its own connections alive instead
+}
+
+liboai::netimpl::ConnectionPool::~ConnectionPool() {
+	std::lock_guard<std::mutex> lock(this->mutex_);
+	for (auto& [key, handles] : this->idle_) {
+		for (Idle& idle : handles) {
+			curl_easy_cleanup(idle.handle);
+		}
+	}
+	this->idle_.clear();
+
+	// fails with CURLSHE_IN_USE while handles are still checked out at
+	// exit; the share is left to the OS in that case
+	if (this->share_ && curl_share_cleanup(this->share_) == CURLSHE_OK) {
+		this->share_ = nullptr;
+	}
+}
+
+void liboai::netimpl::ConnectionPool::LockShare(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+	static_cast<ConnectionPool*>(userptr)->share_locks_[data].lock();
+}
+
+void liboai::netimpl::ConnectionPool::UnlockShare(CURL*, curl_lock_data data, void* userptr) {
+	static_cast<ConnectionPool*>(userptr)->share_locks_[data].unlock();
+}
+
+CURLcode liboai::netimpl::ConnectionPool::Share(CURL* handle) noexcept {
+	if (!this->share_) {
+		return CURLcode::CURLE_OK;
+	}
+	return curl_easy_setopt(handle, CURLOPT_SHARE, this->share_);
+}
+
+CURL* liboai::netimpl::ConnectionPool::Checkout(const std::string& url, ResponseBuffers* buffers) {
+	CURL* handle = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		auto it = this->idle_.find(KeyFromUrl(url));
+		if (it != this->idle_.end() && !it->second.empty()) {
+			handle = it->second.back().handle;
+			if (buffers) {
+				*buffers = std::move(it->second.back().buffers);
+			}
+			it->second.pop_back();
+			++this->stats_.hits;
+		}
+		else {
+			++this->stats_.misses;
+		}
+	}
+
+	if (!handle) {
+		handle = curl_easy_init();
+		if (!handle) {
+			throw liboai::exception::OpenAIException(
+				curl_easy_strerror(CURLE_FAILED_INIT),
+				liboai::exception::EType::E_CURLERROR,
+				"liboai::netimpl::ConnectionPool::Checkout()"
+			);
+		}
+	}
+
+	// options are cleared by curl_easy_reset() on checkin, so the
+	// connection-level settings are applied on every checkout
+	CURLcode e[5]; memset(e, CURLcode::CURLE_OK, sizeof(e));
+	e[0] = curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+	e[1] = curl_easy_setopt(handle, CURLOPT_TCP_KEEPIDLE, 60L);
+	e[2] = curl_easy_setopt(handle, CURLOPT_TCP_KEEPINTVL, 30L);
+	if (curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2) {
+		// HTTP/2 over TLS when the server offers it; the reactor's
+		// async transfers to the same host multiplex over one connection
+		// of its multi handle, a blocking transfer uses its handle's own
+		e[3] = curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+	}
+	e[4] = this->Share(handle);
+
+	#if defined(LIBOAI_DEBUG)
+		curl_easy_setopt(handle, CURLOPT_VERBOSE, 1L);
+	#endif
+
+	ErrorCheck(e, 5, "liboai::netimpl::ConnectionPool::Checkout()");
+	return handle;
+}
+
+void liboai::netimpl::ConnectionPool::Checkin(const std::string& key, CURL* handle, ResponseBuffers&& buffers) {
+	if (!handle) {
+		return;
+	}
+
+	curl_easy_reset(handle);
+	buffers.Clear();
+
+	std::unique_lock<std::mutex> lock(this->mutex_);
+	auto& handles = this->idle_[key];
+	if (handles.size() < this->max_idle_) {
+		handles.push_back({ handle, std::move(buffers) });
+		return;
+	}
+	lock.unlock();
+
+	curl_easy_cleanup(handle);
+}
+
+void liboai::netimpl::ConnectionPool::Record(CURL* handle) {
+	long connects = 0;
+	curl_off_t connect_us = 0, appconnect_us = 0;
+	curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects);
+	curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &connect_us);
+	curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME_T, &appconnect_us);
+
+	std::lock_guard<std::mutex> lock(this->mutex_);
+	if (connects > 0) {
+		this->stats_.connects += static_cast<uint64_t>(connects);
+		// app connect covers the TLS handshake; plain http only has the connect
+		this->stats_.handshake_ms += static_cast<double>(std::max(connect_us, appconnect_us)) / 1000.0;
+	}
+	else {
+		++this->stats_.reused;
+	}
+}
+
+void liboai::netimpl::ConnectionPool::SetMaxIdle(size_t max_idle) noexcept {
+	std::lock_guard<std::mutex> lock(this->mutex_);
+	this->max_idle_ = max_idle;
+}
+
+liboai::netimpl::ConnectionPool::Stats liboai::netimpl::ConnectionPool::GetStats() const {
+	std::lock_guard<std::mutex> lock(this->mutex_);
+	return this->stats_;
+}
+
+std::string liboai::netimpl::ConnectionPool::KeyFromUrl(const std::string& url) {
+	// scheme://host[:port] -- everything up to the first '/' after the authority
+	const size_t scheme_end = url.find("://");
+	if (scheme_end == std::string::npos) {
+		return url;
+	}
+	const size_t path_start = url.find_first_of("/?", scheme_end + 3);
+	return url.substr(0, path_start);
+}
+
 liboai::netimpl::Session::~Session() {	
 	if (this->headers) {
 		curl_slist_free_all(this->headers);
@@ -160,24 +355,25 @@ void liboai::netimpl::Session::Prepare() {
 	// set string the response will be sent to
 	if (!this->write_.callback) {
 		e[6] = curl_easy_setopt(this->curl_, CURLOPT_WRITEFUNCTION, liboai::netimpl::components::writeFunction);
-		e[7] = curl_easy_setopt(this->curl_, CURLOPT_WRITEDATA, &this->response_string_);
+		e[7] = curl_easy_setopt(this->curl_, CURLOPT_WRITEDATA, &this->buffers_.body);
 		
 		#if defined(LIBOAI_DEBUG)
 			_liboai_dbg(
 				"[dbg] [@%s] No user supplied WriteCallback. Set CURLOPT_WRITEFUNCTION and CURLOPT_WRITEDATA for Session (0x%p) to 0x%p and 0x%p.\n",
-				__func__, this, liboai::netimpl::components::writeFunction, &this->response_string_
+				__func__, this, liboai::netimpl::components::writeFunction, &this->buffers_.body
 			);
 		#endif
 	}
 
-	// set string the raw headers will be sent to
-	e[8] = curl_easy_setopt(this->curl_, CURLOPT_HEADERFUNCTION, liboai::netimpl::components::writeFunction);
-	e[9] = curl_easy_setopt(this->curl_, CURLOPT_HEADERDATA, &this->header_string_);
+	// set buffers the raw headers will be sent to; Content-Length
+	// pre-sizes the body buffer
+	e[8] = curl_easy_setopt(this->curl_, CURLOPT_HEADERFUNCTION, liboai::netimpl::components::headerFunction);
+	e[9] = curl_easy_setopt(this->curl_, CURLOPT_HEADERDATA, &this->buffers_);
 
 	#if defined(LIBOAI_DEBUG)
 		_liboai_dbg(
 			"[dbg] [@%s] Set CURLOPT_HEADERFUNCTION and CURLOPT_HEADERDATA for Session (0x%p) to 0x%p and 0x%p.\n",
-			__func__, this, liboai::netimpl::components::writeFunction, &this->header_string_
+			__func__, this, liboai::netimpl::components::headerFunction, &this->buffers_
 		);
 	#endif
 
@@ -229,12 +425,12 @@ void liboai::netimpl::Session::PrepareDownloadInternal() {
 	}
 
 	e[4] = curl_easy_setopt(this->curl_, CURLOPT_HEADERFUNCTION, liboai::netimpl::components::writeFunction);
-	e[5] = curl_easy_setopt(this->curl_, CURLOPT_HEADERDATA, &this->header_string_);
+	e[5] = curl_easy_setopt(this->curl_, CURLOPT_HEADERDATA, &this->buffers_.headers);
 
 	#if defined(LIBOAI_DEBUG)
 		_liboai_dbg(
 			"[dbg] [@%s] Set CURLOPT_HEADERFUNCTION and CURLOPT_HEADERDATA for Session (0x%p) to 0x%p and 0x%p.\n",
-			__func__, this, liboai::netimpl::components::writeFunction, &this->header_string_
+			__func__, this, liboai::netimpl::components::writeFunction, &this->buffers_.headers
 		);
 	#endif
 		
@@ -249,11 +445,66 @@ CURLcode liboai::netimpl::Session::Perform() {
 		);
 	#endif
 
-	CURLcode e = curl_easy_perform(this->curl_);		
+	CURLcode e = this->Stopped(curl_easy_perform(this->curl_));
+	ConnectionPool::Instance().Record(this->curl_);
+	this->RethrowWriteError();
 	ErrorCheck(e, "liboai::netimpl::Session::Perform()");
 	return e;
 }
 
+CURLcode liboai::netimpl::Session::Stopped(CURLcode result) const noexcept {
+	// a user WriteCallback returning false aborts the transfer on
+	// purpose (e.g. a stream that already has what it needs), so
+	// the response received so far is complete as far as we care
+	if (result == CURLE_WRITE_ERROR && this->write_.callback) {
+		#if defined(LIBOAI_DEBUG)
+			_liboai_dbg(
+				"[dbg] [@%s] Transfer for Session (0x%p) stopped by WriteCallback.\n",
+				__func__, this
+			);
+		#endif
+
+		return CURLE_OK;
+	}
+	return result;
+}
+
+void liboai::netimpl::Session::RethrowWriteError() {
+	if (this->write_error_) {
+		std::rethrow_exception(std::exchange(this->write_error_, nullptr));
+	}
+}
+
+size_t liboai::netimpl::Session::WriteStream(char* ptr, size_t size, size_t nmemb, Session* session) {
+	#if defined(LIBOAI_DEBUG)
+		_liboai_dbg(
+			"[dbg] [@%s] Called with %zu bytes.\n",
+			__func__, size * nmemb
+		);
+	#endif
+
+	size *= nmemb;
+
+	// an error status carries a JSON error body rather than events;
+	// keep it for the Response so the error detail is not lost
+	long status = 0;
+	curl_easy_getinfo(session->curl_, CURLINFO_RESPONSE_CODE, &status);
+	if (status != 0 && (status < 200 || status >= 300)) {
+		session->buffers_.body.append(ptr, size);
+		return size;
+	}
+
+	// exceptions must not unwind through libcurl's C frames; the
+	// transfer is aborted and the exception rethrown once it returns
+	try {
+		return session->write_({ ptr, size }) ? size : 0;
+	}
+	catch (...) {
+		session->write_error_ = std::current_exception();
+		return 0;
+	}
+}
+
 liboai::Response liboai::netimpl::Session::BuildResponseObject() {
 	// holds error codes - all init to OK to prevent errors
 	// when checking unset values
@@ -266,8 +517,9 @@ liboai::Response liboai::netimpl::Session::BuildResponseObject() {
 		);
 	#endif	
 
-	// fill status line and reason
-	this->ParseResponseHeader(this->header_string_, &this->status_line, &this->reason);
+	// fill status line, reason and the server's requested retry delay
+	long retry_after_ms = -1;
+	this->ParseResponseHeader(this->buffers_.headers, &this->status_line, &this->reason, &retry_after_ms);
 
 	#if defined(LIBOAI_DEBUG)
 		_liboai_dbg(
@@ -303,8 +555,10 @@ liboai::Response liboai::netimpl::Session::BuildResponseObject() {
 
 	ErrorCheck(e, 3, "liboai::netimpl::Session::BuildResponseObject()");
 
-	// fill content
-	this->content = this->response_string_;
+	// fill content; the body buffer is handed over, not copied, and the
+	// storage of a destroyed response takes its place for the next one
+	this->content = std::move(this->buffers_.body);
+	this->buffers_.body = liboai::Response::TakeRecycledBody();
 	
 	#if defined(LIBOAI_DEBUG)
 		_liboai_dbg(
@@ -319,7 +573,8 @@ liboai::Response liboai::netimpl::Session::BuildResponseObject() {
 		std::move(this->status_line),
 		std::move(this->reason),
 		this->status_code,
-		this->elapsed
+		this->elapsed,
+		retry_after_ms
 	};
 }
 
@@ -613,7 +868,7 @@ liboai::Response liboai::netimpl::Session::Download(std::ofstream& file) {
 	return CompleteDownload();
 }
 
-void liboai::netimpl::Session::ParseResponseHeader(const std::string& headers, std::string* status_line, std::string* reason) {
+void liboai::netimpl::Session::ParseResponseHeader(const std::string& headers, std::string* status_line, std::string* reason, long* retry_after_ms) {
     std::vector<std::string> lines;
     std::istringstream stream(headers);
     {
@@ -653,6 +908,27 @@ void liboai::netimpl::Session::ParseResponseHeader(const std::string& headers, s
                 std::string value = line.substr(found + 1);
                 value.erase(0, value.find_first_not_of("\t "));
                 value.resize(std::min<size_t>(value.size(), value.find_last_not_of("\t\n\r ") + 1));
+
+                // Retry-After is either delay-seconds or an HTTP-date;
+                // retry-after-ms is the millisecond variant some APIs send
+                if (retry_after_ms != nullptr && !value.empty()) {
+                    std::string name = line.substr(0, found);
+                    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+                    if (name == "retry-after-ms") {
+                        *retry_after_ms = std::strtol(value.c_str(), nullptr, 10);
+                    }
+                    else if (name == "retry-after" && *retry_after_ms < 0) {
+                        if (std::isdigit(static_cast<unsigned char>(value[0]))) {
+                            *retry_after_ms = static_cast<long>(std::strtod(value.c_str(), nullptr) * 1000.0);
+                        }
+                        else {
+                            const time_t at = curl_getdate(value.c_str(), nullptr);
+                            if (at != -1) {
+                                *retry_after_ms = std::max<long>(0, static_cast<long>(at - time(nullptr)) * 1000);
+                            }
+                        }
+                    }
+                }
             }
         }
     }
@@ -671,6 +947,7 @@ void liboai::netimpl::Session::SetOption(const components::Url& url) {
 
 void liboai::netimpl::Session::SetUrl(const components::Url& url) {
 	this->url_ = url.str();
+	this->Checkout(this->url_);
 
 	#if defined(LIBOAI_DEBUG)
 		_liboai_dbg(
@@ -726,6 +1003,36 @@ void liboai::netimpl::Session::SetBody(components::Body&& body) {
 	ErrorCheck(e, 2, "liboai::netimpl::Session::SetBody()");
 }
 
+void liboai::netimpl::Session::SetOption(components::SegmentedBody&& body) {
+	this->SetSegmentedBody(std::move(body));
+}
+
+void liboai::netimpl::Session::SetSegmentedBody(components::SegmentedBody&& body) {
+	// holds error codes - all init to OK to prevent errors
+	// when checking unset values
+	CURLcode e[6]; memset(e, CURLcode::CURLE_OK, sizeof(e));
+
+	this->hasBody = true;
+	this->segments_ = std::move(body);
+	this->segments_.Seek(0);
+
+	e[0] = curl_easy_setopt(this->curl_, CURLOPT_POST, 1L);
+	e[1] = curl_easy_setopt(this->curl_, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(this->segments_.size()));
+	e[2] = curl_easy_setopt(this->curl_, CURLOPT_READFUNCTION, components::readSegmentsFunction);
+	e[3] = curl_easy_setopt(this->curl_, CURLOPT_READDATA, &this->segments_);
+	e[4] = curl_easy_setopt(this->curl_, CURLOPT_SEEKFUNCTION, components::seekSegmentsFunction);
+	e[5] = curl_easy_setopt(this->curl_, CURLOPT_SEEKDATA, &this->segments_);
+
+	#if defined(LIBOAI_DEBUG)
+		_liboai_dbg(
+			"[dbg] [@%s] Set CURLOPT_READFUNCTION and CURLOPT_SEEKFUNCTION for Session (0x%p) to stream a %zu byte body.\n",
+			__func__, this, this->segments_.size()
+		);
+	#endif
+
+	ErrorCheck(e, 6, "liboai::netimpl::Session::SetSegmentedBody()");
+}
+
 void liboai::netimpl::Session::SetOption(const components::Multipart& multipart) {
 	this->SetMultipart(multipart);
 }
@@ -957,6 +1264,245 @@ void liboai::netimpl::Session::SetMultipart(components::Multipart&& multipart) {
 	#endif
 }
 
+liboai::netimpl::Reactor::Reactor() {
+	// constructed first so the pool outlives the reactor at exit
+	ConnectionPool::Instance();
+
+	this->multi_ = curl_multi_init();
+	if (!this->multi_) {
+		throw liboai::exception::OpenAIException(
+			curl_easy_strerror(CURLE_FAILED_INIT),
+			liboai::exception::EType::E_CURLERROR,
+			"liboai::netimpl::Reactor::Reactor()"
+		);
+	}
+	curl_multi_setopt(this->multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+}
+
+liboai::netimpl::Reactor::~Reactor() {
+	this->stop_ = true;
+	curl_multi_wakeup(this->multi_);
+	if (this->thread_.joinable()) {
+		this->thread_.join();
+	}
+
+	// fail whatever is still queued or in flight
+	std::lock_guard<std::mutex> lock(this->mutex_);
+	auto stopped = std::make_exception_ptr(liboai::exception::OpenAIException(
+		"Reactor stopped before the transfer completed",
+		liboai::exception::EType::E_CONNECTIONERROR,
+		"liboai::netimpl::Reactor::~Reactor()"
+	));
+	for (auto& [handle, transfer] : this->active_) {
+		curl_multi_remove_handle(this->multi_, handle);
+		Reject(*transfer, stopped);
+	}
+	for (auto& transfer : this->queue_) {
+		Reject(*transfer, stopped);
+	}
+	this->active_.clear();
+	this->queue_.clear();
+
+	curl_multi_cleanup(this->multi_);
+	this->multi_ = nullptr;
+}
+
+liboai::FutureResponse liboai::netimpl::Reactor::Submit(std::unique_ptr<Session> session, Method method) {
+	// options are applied on the caller's thread; errors surface here
+	switch (method) {
+		case Method::HTTP_GET:    session->PrepareGet();    break;
+		case Method::HTTP_POST:   session->PreparePost();   break;
+		case Method::HTTP_DELETE: session->PrepareDelete(); break;
+	}
+
+	auto transfer = std::make_unique<Transfer>();
+	transfer->session = std::move(session);
+	liboai::FutureResponse future = transfer->promise.get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		this->queue_.push_back(std::move(transfer));
+	}
+
+	std::call_once(this->started_, [this]() {
+		this->thread_ = std::thread(&Reactor::Run, this);
+	});
+	curl_multi_wakeup(this->multi_);
+
+	#if defined(LIBOAI_DEBUG)
+		_liboai_dbg(
+			"[dbg] [@%s] Queued transfer; %zu pending.\n",
+			__func__, this->Pending()
+		);
+	#endif
+
+	return future;
+}
+
+void liboai::netimpl::Reactor::SetMaxConcurrency(size_t max_concurrency) {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		this->max_concurrency_ = max_concurrency;
+	}
+	curl_multi_wakeup(this->multi_);
+}
+
+size_t liboai::netimpl::Reactor::GetMaxConcurrency() const {
+	std::lock_guard<std::mutex> lock(this->mutex_);
+	return this->max_concurrency_;
+}
+
+size_t liboai::netimpl::Reactor::InFlight() const {
+	std::lock_guard<std::mutex> lock(this->mutex_);
+	return this->active_.size();
+}
+
+size_t liboai::netimpl::Reactor::Pending() const {
+	std::lock_guard<std::mutex> lock(this->mutex_);
+	return this->queue_.size();
+}
+
+void liboai::netimpl::Reactor::Run() {
+	while (!this->stop_) {
+		if (this->sweep_.exchange(false)) {
+			this->DropCancelled();
+		}
+		this->Admit();
+
+		int running = 0;
+		curl_multi_perform(this->multi_, &running);
+
+		int remaining = 0;
+		bool finished = false;
+		while (CURLMsg* msg = curl_multi_info_read(this->multi_, &remaining)) {
+			if (msg->msg == CURLMSG_DONE) {
+				this->Finish(msg->easy_handle, msg->data.result);
+				finished = true;
+			}
+		}
+
+		// freed slots are refilled from the queue before sleeping
+		if (finished) {
+			continue;
+		}
+
+		// sleeps until socket activity, a timeout or curl_multi_wakeup()
+		curl_multi_poll(this->multi_, nullptr, 0, 1000, nullptr);
+	}
+}
+
+void liboai::netimpl::Reactor::Sweep() {
+	this->sweep_ = true;
+	curl_multi_wakeup(this->multi_);
+}
+
+void liboai::netimpl::Reactor::DropCancelled() {
+	std::vector<std::unique_ptr<Transfer>> dropped;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		for (auto it = this->queue_.begin(); it != this->queue_.end();) {
+			if ((*it)->session->cancel_.Cancelled()) {
+				dropped.push_back(std::move(*it));
+				it = this->queue_.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+		for (auto it = this->active_.begin(); it != this->active_.end();) {
+			if (it->second->session->cancel_.Cancelled()) {
+				curl_multi_remove_handle(this->multi_, it->first);
+				dropped.push_back(std::move(it->second));
+				it = this->active_.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	#if defined(LIBOAI_DEBUG)
+		_liboai_dbg(
+			"[dbg] [@%s] Dropped %zu cancelled transfers.\n",
+			__func__, dropped.size()
+		);
+	#endif
+
+	// destroying the sessions checks the handles back into the pool
+	for (auto& transfer : dropped) {
+		Reject(*transfer, std::make_exception_ptr(liboai::exception::OpenAIException(
+			"Request cancelled",
+			liboai::exception::EType::E_CANCELLED,
+			"liboai::netimpl::Reactor::DropCancelled()"
+		)));
+	}
+}
+
+void liboai::netimpl::Reactor::Admit() {
+	std::lock_guard<std::mutex> lock(this->mutex_);
+	while (!this->queue_.empty() &&
+		(this->max_concurrency_ == 0 || this->active_.size() < this->max_concurrency_)) {
+		std::unique_ptr<Transfer> transfer = std::move(this->queue_.front());
+		this->queue_.pop_front();
+
+		CURL* handle = transfer->session->curl_;
+		CURLMcode e = curl_multi_add_handle(this->multi_, handle);
+		if (e != CURLM_OK) {
+			Reject(*transfer, std::make_exception_ptr(liboai::exception::OpenAIException(
+				curl_multi_strerror(e),
+				liboai::exception::EType::E_CURLERROR,
+				"liboai::netimpl::Reactor::Admit()"
+			)));
+			continue;
+		}
+		this->active_.emplace(handle, std::move(transfer));
+	}
+}
+
+void liboai::netimpl::Reactor::Finish(CURL* handle, CURLcode result) {
+	std::unique_ptr<Transfer> transfer;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		auto it = this->active_.find(handle);
+		if (it == this->active_.end()) {
+			return;
+		}
+		transfer = std::move(it->second);
+		this->active_.erase(it);
+	}
+
+	curl_multi_remove_handle(this->multi_, handle);
+	ConnectionPool::Instance().Record(handle);
+
+	try {
+		transfer->session->RethrowWriteError();
+		ErrorCheck(transfer->session->Stopped(result), "liboai::netimpl::Reactor::Finish()");
+		Resolve(*transfer, transfer->session->Complete());
+	}
+	catch (...) {
+		Reject(*transfer, std::current_exception());
+	}
+
+	// destroying the session checks the handle back into the pool
+	transfer->session.reset();
+}
+
+void liboai::netimpl::Reactor::Resolve(Transfer& transfer, liboai::Response response) {
+	transfer.session->hook_(&response, nullptr);
+	transfer.promise.set_value(std::move(response));
+}
+
+void liboai::netimpl::Reactor::Reject(Transfer& transfer, std::exception_ptr error) {
+	transfer.session->hook_(nullptr, error);
+	transfer.promise.set_exception(std::move(error));
+}
+
+void liboai::netimpl::components::CancelToken::Cancel() const {
+	if (this->flag_ && !this->flag_->exchange(true)) {
+		Reactor::Instance().Sweep();
+	}
+}
+
 std::string liboai::netimpl::CurlHolder::urlEncode(const std::string& s) {
 	#if defined(LIBOAI_DEBUG)
 		_liboai_dbg(
@@ -1001,16 +1547,55 @@ std::string liboai::netimpl::components::urlDecodeHelper(const std::string& s) {
 	return c.urlDecode(s);
 }
 
-size_t liboai::netimpl::components::writeUserFunction(char* ptr, size_t size, size_t nmemb, const WriteCallback* write) {
-	#if defined(LIBOAI_DEBUG)
-		_liboai_dbg(
-			"[dbg] [@%s] Called with %zu bytes.\n",
-			__func__, size * nmemb
-		);
-	#endif
-		
-	size *= nmemb;
-	return (*write)({ ptr, size }) ? size : 0;
+size_t liboai::netimpl::components::readSegmentsFunction(char* ptr, size_t size, size_t nitems, SegmentedBody* body) {
+	return body->Read(ptr, size * nitems);
+}
+
+int liboai::netimpl::components::seekSegmentsFunction(SegmentedBody* body, curl_off_t offset, int origin) {
+	if (origin != SEEK_SET || offset < 0) {
+		return CURL_SEEKFUNC_CANTSEEK;
+	}
+	return body->Seek(static_cast<size_t>(offset)) ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+}
+
+std::string liboai::netimpl::components::SegmentedBody::str() const {
+	std::string result;
+	result.reserve(this->size_);
+	for (const auto& part : this->parts_) {
+		result += *part;
+	}
+	return result;
+}
+
+size_t liboai::netimpl::components::SegmentedBody::Read(char* buffer, size_t length) noexcept {
+	size_t copied = 0;
+	while (copied < length && this->part_ < this->parts_.size()) {
+		const std::string& part = *this->parts_[this->part_];
+		const size_t n = std::min(length - copied, part.size() - this->offset_);
+		memcpy(buffer + copied, part.data() + this->offset_, n);
+		copied += n;
+		this->offset_ += n;
+
+		if (this->offset_ == part.size()) {
+			++this->part_;
+			this->offset_ = 0;
+		}
+	}
+	return copied;
+}
+
+bool liboai::netimpl::components::SegmentedBody::Seek(size_t offset) noexcept {
+	if (offset > this->size_) {
+		return false;
+	}
+	// cURL only rewinds on redirects and retries, a linear walk is fine
+	this->part_ = 0;
+	while (this->part_ < this->parts_.size() && offset >= this->parts_[this->part_]->size()) {
+		offset -= this->parts_[this->part_]->size();
+		++this->part_;
+	}
+	this->offset_ = offset;
+	return true;
 }
 
 size_t liboai::netimpl::components::writeFunction(char* ptr, size_t size, size_t nmemb, std::string* data) {
@@ -1026,6 +1611,35 @@ size_t liboai::netimpl::components::writeFunction(char* ptr, size_t size, size_t
 	return size;
 }
 
+size_t liboai::netimpl::components::headerFunction(char* ptr, size_t size, size_t nmemb, ResponseBuffers* buffers) {
+	size *= nmemb;
+	buffers->headers.append(ptr, size);
+
+	// reserve the body once the length is known instead of growing it
+	// chunk by chunk; compressed bodies may still grow past it when
+	// decoded, and absurd lengths are not trusted beyond a cap
+	static constexpr std::string_view name = "content-length:";
+	static constexpr size_t max_reserve = 64u << 20;
+	if (size > name.size() && buffers->body.empty()) {
+		const bool match = std::equal(name.begin(), name.end(), ptr,
+			[](char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); }
+		);
+		if (match) {
+			const size_t length = std::strtoull(std::string(ptr + name.size(), size - name.size()).c_str(), nullptr, 10);
+			buffers->body.reserve(std::min(length, max_reserve));
+
+			#if defined(LIBOAI_DEBUG)
+				_liboai_dbg(
+					"[dbg] [@%s] Reserved %zu bytes for the response body.\n",
+					__func__, buffers->body.capacity()
+				);
+			#endif
+		}
+	}
+
+	return size;
+}
+
 size_t liboai::netimpl::components::writeFileFunction(char* ptr, size_t size, size_t nmemb, std::ofstream* file) {
 	#if defined(LIBOAI_DEBUG)
 		_liboai_dbg(
@@ -1312,9 +1926,9 @@ void liboai::netimpl::Session::SetWriteCallback(const components::WriteCallback&
 	if (write.callback) {
 		CURLcode e[2]; memset(e, CURLcode::CURLE_OK, sizeof(e));
 
-		e[0] = curl_easy_setopt(this->curl_, CURLOPT_WRITEFUNCTION, components::writeUserFunction);
+		e[0] = curl_easy_setopt(this->curl_, CURLOPT_WRITEFUNCTION, Session::WriteStream);
 		this->write_ = write;
-		e[1] = curl_easy_setopt(this->curl_, CURLOPT_WRITEDATA, &this->write_);
+		e[1] = curl_easy_setopt(this->curl_, CURLOPT_WRITEDATA, this);
 
 		#if defined(LIBOAI_DEBUG)
 				_liboai_dbg(
@@ -1327,6 +1941,14 @@ void liboai::netimpl::Session::SetWriteCallback(const components::WriteCallback&
 	}
 }
 
+void liboai::netimpl::Session::SetOption(const components::CancelToken& cancel) {
+	this->cancel_ = cancel;
+}
+
+void liboai::netimpl::Session::SetOption(components::CompletionHook&& hook) {
+	this->hook_ = std::move(hook);
+}
+
 void liboai::netimpl::Session::SetOption(components::WriteCallback&& write) {
 	this->SetWriteCallback(std::move(write));
 }
@@ -1335,9 +1957,9 @@ void liboai::netimpl::Session::SetWriteCallback(components::WriteCallback&& writ
 	if (write.callback) {
 		CURLcode e[2]; memset(e, CURLcode::CURLE_OK, sizeof(e));
 
-		e[0] = curl_easy_setopt(this->curl_, CURLOPT_WRITEFUNCTION, components::writeUserFunction);
+		e[0] = curl_easy_setopt(this->curl_, CURLOPT_WRITEFUNCTION, Session::WriteStream);
 		this->write_ = std::move(write);
-		e[1] = curl_easy_setopt(this->curl_, CURLOPT_WRITEDATA, &this->write_);
+		e[1] = curl_easy_setopt(this->curl_, CURLOPT_WRITEDATA, this);
 
 		#if defined(LIBOAI_DEBUG)
 			_liboai_dbg(
@@ -1,16 +1,36 @@
 #include "../include/core/response.h"
+#include <mutex>
+
+namespace {
+	// storage of destroyed response bodies; bounded in count and size so
+	// a burst of large responses does not stay pinned in memory
+	struct RecycledBodies {
+		static constexpr size_t max_count = 16;
+		static constexpr size_t min_capacity = 256;
+		static constexpr size_t max_capacity = 4u << 20;
+
+		std::mutex mutex;
+		std::vector<std::string> bodies;
+
+		static RecycledBodies& Instance() noexcept {
+			// never destroyed, responses may outlive static destruction
+			static RecycledBodies* instance = new RecycledBodies();
+			return *instance;
+		}
+	};
+}
 
 liboai::Response::Response(const liboai::Response& other) noexcept
-	: status_code(other.status_code), elapsed(other.elapsed), status_line(other.status_line),
+	: status_code(other.status_code), elapsed(other.elapsed), retry_after_ms(other.retry_after_ms), status_line(other.status_line),
 	content(other.content), url(other.url), reason(other.reason), raw_json(other.raw_json) {}
 
 liboai::Response::Response(liboai::Response&& other) noexcept
-	: status_code(other.status_code), elapsed(other.elapsed), status_line(std::move(other.status_line)),
+	: status_code(other.status_code), elapsed(other.elapsed), retry_after_ms(other.retry_after_ms), status_line(std::move(other.status_line)),
 	content(std::move(other.content)), url(std::move(other.url)), reason(std::move(other.reason)), raw_json(std::move(other.raw_json)) {}
 
-liboai::Response::Response(std::string&& url, std::string&& content, std::string&& status_line, std::string&& reason, long status_code, double elapsed) noexcept(false) 
-	: status_code(status_code), elapsed(elapsed), status_line(std::move(status_line)),
-	content(std::move(content)), url(url), reason(std::move(reason))
+liboai::Response::Response(std::string&& url, std::string&& content, std::string&& status_line, std::string&& reason, long status_code, double elapsed, long retry_after_ms) noexcept(false) 
+	: status_code(status_code), elapsed(elapsed), retry_after_ms(retry_after_ms), status_line(std::move(status_line)),
+	content(std::move(content)), url(std::move(url)), reason(std::move(reason))
 {
 	try {
 		if (!this->content.empty()) {
@@ -29,7 +49,8 @@ liboai::Response::Response(std::string&& url, std::string&& content, std::string
 		throw liboai::exception::OpenAIException(
 			e.what(),
 			liboai::exception::EType::E_FAILURETOPARSE,
-			"liboai::Response::Response(std::string&&, std::string&&, ...)"
+			"liboai::Response::Response(std::string&&, std::string&&, ...)",
+			this->status_code, this->content
 		);
 	}
 
@@ -37,9 +58,35 @@ liboai::Response::Response(std::string&& url, std::string&& content, std::string
 	this->CheckResponse();
 }
 
+liboai::Response::~Response() {
+	const size_t capacity = this->content.capacity();
+	if (capacity < RecycledBodies::min_capacity || capacity > RecycledBodies::max_capacity) {
+		return;
+	}
+
+	auto& recycled = RecycledBodies::Instance();
+	std::lock_guard<std::mutex> lock(recycled.mutex);
+	if (recycled.bodies.size() < RecycledBodies::max_count) {
+		this->content.clear();
+		recycled.bodies.push_back(std::move(this->content));
+	}
+}
+
+std::string liboai::Response::TakeRecycledBody() noexcept {
+	auto& recycled = RecycledBodies::Instance();
+	std::lock_guard<std::mutex> lock(recycled.mutex);
+	if (recycled.bodies.empty()) {
+		return {};
+	}
+	std::string body = std::move(recycled.bodies.back());
+	recycled.bodies.pop_back();
+	return body;
+}
+
 liboai::Response& liboai::Response::operator=(const liboai::Response& other) noexcept {
 	this->status_code = other.status_code;
 	this->elapsed = other.elapsed;
+	this->retry_after_ms = other.retry_after_ms;
 	this->status_line = other.status_line;
 	this->content = other.content;
 	this->url = other.url;
@@ -52,6 +99,7 @@ liboai::Response& liboai::Response::operator=(const liboai::Response& other) noe
 liboai::Response& liboai::Response::operator=(liboai::Response&& other) noexcept {
 	this->status_code = other.status_code;
 	this->elapsed = other.elapsed;
+	this->retry_after_ms = other.retry_after_ms;
 	this->status_line = std::move(other.status_line);
 	this->content = std::move(other.content);
 	this->url = std::move(other.url);
@@ -66,12 +114,37 @@ std::ostream& liboai::operator<<(std::ostream& os, const Response& r) {
 	return os;
 }
 
+std::string_view liboai::Response::GetMessageContent() const noexcept {
+	auto choices = this->raw_json.find("choices");
+	if (choices == this->raw_json.end() || !choices->is_array() || choices->empty()) {
+		return {};
+	}
+
+	auto message = choices->front().find("message");
+	if (message == choices->front().end()) {
+		return {};
+	}
+
+	auto content = message->find("content");
+	if (content == message->end() || !content->is_string()) {
+		return {}; // e.g. null content
+	}
+	return content->get_ref<const std::string&>();
+}
+
+const nlohmann::json& liboai::Response::GetUsage() const noexcept {
+	static const nlohmann::json none{};
+	auto usage = this->raw_json.find("usage");
+	return usage != this->raw_json.end() ? *usage : none;
+}
+
 void liboai::Response::CheckResponse() const noexcept(false) {
 	if (this->status_code == 429) {
 		throw liboai::exception::OpenAIRateLimited(
 			!this->reason.empty() ? this->reason : "Rate limited",
 			liboai::exception::EType::E_RATELIMIT,
-			"liboai::Response::CheckResponse()"
+			"liboai::Response::CheckResponse()",
+			this->retry_after_ms, this->content
 		);
 	}
 	else if (this->status_code == 0) {
@@ -87,14 +160,16 @@ void liboai::Response::CheckResponse() const noexcept(false) {
 				throw liboai::exception::OpenAIException(
 					this->raw_json["error"]["message"].get<std::string>(),
 					liboai::exception::EType::E_APIERROR,
-					"liboai::Response::CheckResponse()"
+					"liboai::Response::CheckResponse()",
+					this->status_code, this->content
 				);
 			}
 			catch (nlohmann::json::parse_error& e) {
 				throw liboai::exception::OpenAIException(
 					e.what(),
 					liboai::exception::EType::E_FAILURETOPARSE,
-					"liboai::Response::CheckResponse()"
+					"liboai::Response::CheckResponse()",
+					this->status_code, this->content
 				);
 			}
 		}
@@ -102,7 +177,8 @@ void liboai::Response::CheckResponse() const noexcept(false) {
 			throw liboai::exception::OpenAIException(
 				!this->reason.empty() ? this->reason : "An unknown error occurred",
 				liboai::exception::EType::E_BADREQUEST,
-				"liboai::Response::CheckResponse()"
+				"liboai::Response::CheckResponse()",
+				this->status_code, this->content
 			);
 		}
 	}
@@ -67,6 +67,15 @@ namespace liboai {
 			*/
 			LIBOAI_EXPORT bool UpdateQueue(int max_length) & noexcept(false);
 
+			/*
+				@brief Removes the oldest messages from the conversation.
+					The system message and the latest message are kept,
+					so fewer messages may be removed than requested.
+
+					@param *count     The number of messages to remove.
+			*/
+			LIBOAI_EXPORT bool PopOldestData(size_t count) & noexcept(false);
+
 			/*
 				@brief Merge one conversation to other.
 					@param *to_merge	Conversation to merge.
@@ -174,9 +183,25 @@ namespace liboai {
 					be called from within the stream's callback function
 					receiving the SSEs.
 
-					@param *token The token to update the conversation with.
+					Partial SSE lines are buffered between calls, so the
+					data can be passed in exactly as received.
+
+					@param *data      The raw stream data to update the conversation with.
+					@param *delta     Receives the content carried by the complete
+					                  events in this call.
+					@param *completed Set to true once the terminating [DONE]
+					                  event has been received.
 			*/
-//			LIBOAI_EXPORT bool AppendToken(std::string_view token) & noexcept(false);
+			LIBOAI_EXPORT bool AppendStreamData(std::string_view data, std::string& delta, bool& completed) & noexcept(false);
+
+			/*
+				@brief Returns the usage reported by the streamed method,
+					or null if none arrived. Streamed methods request it
+					with stream_options.include_usage and the server sends
+					it in a usage-only chunk right before [DONE], so a
+					stream aborted early has none.
+			*/
+			LIBOAI_EXPORT const nlohmann::json& GetStreamUsage() const & noexcept;
 
 			/*
 				@brief Returns the raw JSON dump of the internal conversation object
@@ -189,8 +214,44 @@ namespace liboai {
 			*/
 			LIBOAI_EXPORT const nlohmann::json& GetJSON() const& noexcept;
 
+			/*
+				@brief Returns the compact JSON serialization of each message,
+					in order. Serialized messages are cached until they are
+					modified or removed, so a growing conversation only
+					serializes the messages added since the last call.
+			*/
+			LIBOAI_EXPORT const std::vector<std::shared_ptr<const std::string>>& GetSerializedMessages() const & noexcept(false);
+
+			/*
+				@brief Records that the first 'count' messages have been
+					logged and returns how many were logged before. The
+					count follows the messages as older ones are removed
+					from the front and drops back when logged messages are
+					removed, so only messages added since are new.
+
+					@param *count     The number of leading messages now logged.
+			*/
+			LIBOAI_EXPORT size_t MarkLogged(size_t count) const & noexcept;
+
 		private:
+			/*
+				@brief Drops cached serializations from message index 'from'
+					onwards; called by every method that modifies or removes
+					existing messages.
+			*/
+			void Invalidate(size_t from) const noexcept;
+
+			/*
+				@brief Shifts the logged count for 'count' messages erased
+					at index 'first'.
+			*/
+			void Forget(size_t first, size_t count) noexcept;
+
 			nlohmann::json _conversation;
+			std::string _stream_buffer;
+			nlohmann::json _stream_usage;
+			mutable std::vector<std::shared_ptr<const std::string>> _serialized;
+			mutable size_t _logged = 0;
 	};
 
 	class ChatCompletion final : private Network {
@@ -298,6 +359,10 @@ namespace liboai {
 				@param logit_bias        Modify the likelihood of specified tokens appearing in the completion.
 				@param user              The user ID to associate with the request. This is used to
 										 prevent abuse of the API.
+				@param cancel            Token that drops the request from the reactor
+										 when cancelled, e.g. the loser of a hedged pair.
+				@param hook              Called on the reactor thread with the response or
+										 error right before the future completes.
 
 				@returns A liboai::Response future containing the
 					data in JSON format.
@@ -314,10 +379,19 @@ namespace liboai {
 				std::optional<float> presence_penalty = std::nullopt,
 				std::optional<float> frequency_penalty = std::nullopt,
 				std::optional<std::unordered_map<std::string, int8_t>> logit_bias = std::nullopt,
-				std::optional<std::string> user = std::nullopt
+				std::optional<std::string> user = std::nullopt,
+				netimpl::components::CancelToken cancel = {},
+				netimpl::components::CompletionHook hook = {}
 			) const& noexcept(false);
 
 		private:
+			/*
+				@brief Builds the request body from the given parameters and
+					the conversation's cached message serializations without
+					assembling it into a single string.
+			*/
+			netimpl::components::SegmentedBody BuildRequestBody(const JsonConstructor& jcon, const Conversation& conversation) const;
+
 			Authorization& auth_ = Authorization::Authorizer();
 	};
 }
\ No newline at end of file
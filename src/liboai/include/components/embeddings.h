@@ -47,6 +47,8 @@ namespace liboai {
 				@param *model       The model to use for the edit.
 				@param input        The input text to edit.
 				@param user         A unique identifier representing your end-user
+				@param hook         Called on the reactor thread with the response or
+				                    error right before the future completes.
 
 				@return A liboai::Response future containing the image(s)
 					data in JSON format.
@@ -54,9 +56,49 @@ namespace liboai {
 			LIBOAI_EXPORT liboai::FutureResponse create_async(
 				const std::string& model_id,
 				std::optional<std::string> input = std::nullopt,
+				std::optional<std::string> user = std::nullopt,
+				netimpl::components::CompletionHook hook = {}
+			) const & noexcept(false);
+
+			/*
+				@brief Creates embedding vectors for several inputs in one
+					request. The response's 'data' array holds one
+					embedding per input, each tagged with the 'index'
+					of its input.
+
+				@param *model       The model to use for the embeddings.
+				@param *inputs      The input texts to embed.
+				@param user         A unique identifier representing your end-user
+
+				@return A liboai::Response object containing the embeddings
+					data in JSON format.
+			*/
+			LIBOAI_EXPORT liboai::Response create(
+				const std::string& model_id,
+				const std::vector<std::string>& inputs,
 				std::optional<std::string> user = std::nullopt
 			) const & noexcept(false);
 
+			/*
+				@brief Asynchronously creates embedding vectors for several
+					inputs in one request.
+
+				@param *model       The model to use for the embeddings.
+				@param *inputs      The input texts to embed.
+				@param user         A unique identifier representing your end-user
+				@param hook         Called on the reactor thread with the response or
+				                    error right before the future completes.
+
+				@return A liboai::Response future containing the embeddings
+					data in JSON format.
+			*/
+			LIBOAI_EXPORT liboai::FutureResponse create_async(
+				const std::string& model_id,
+				const std::vector<std::string>& inputs,
+				std::optional<std::string> user = std::nullopt,
+				netimpl::components::CompletionHook hook = {}
+			) const & noexcept(false);
+
 		private:
 			Authorization& auth_ = Authorization::Authorizer();
 	};
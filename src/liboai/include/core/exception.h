@@ -24,28 +24,30 @@ namespace liboai {
 			E_RATELIMIT,
 			E_CONNECTIONERROR,
 			E_FILEERROR,
-			E_CURLERROR
+			E_CURLERROR,
+			E_CANCELLED
 		};
 
-		constexpr const char* _etype_strs_[7] = {
+		constexpr const char* _etype_strs_[8] = {
 			"E_FAILURETOPARSE:0x00",
 			"E_BADREQUEST:0x01",
 			"E_APIERROR:0x02",
 			"E_RATELIMIT:0x03",
 			"E_CONNECTIONERROR:0x04",
 			"E_FILEERROR:0x05",
-			"E_CURLERROR:0x06"
+			"E_CURLERROR:0x06",
+			"E_CANCELLED:0x07"
 		};
 
 		class OpenAIException : public std::exception {
 			public:
 				OpenAIException() = default;
                                 OpenAIException(const OpenAIException& rhs) noexcept
-					: error_type_(rhs.error_type_), data_(rhs.data_), locale_(rhs.locale_) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+					: error_type_(rhs.error_type_), data_(rhs.data_), locale_(rhs.locale_), status_code_(rhs.status_code_), body_(rhs.body_) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
 				OpenAIException(OpenAIException&& rhs) noexcept
-					: error_type_(rhs.error_type_), data_(std::move(rhs.data_)), locale_(std::move(rhs.locale_)) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
-				OpenAIException(std::string_view data, EType error_type, std::string_view locale) noexcept
-					: error_type_(error_type), data_(data), locale_(locale) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+					: error_type_(rhs.error_type_), data_(std::move(rhs.data_)), locale_(std::move(rhs.locale_)), status_code_(rhs.status_code_), body_(std::move(rhs.body_)) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+				OpenAIException(std::string_view data, EType error_type, std::string_view locale, long status_code = 0, std::string_view body = {}) noexcept
+					: error_type_(error_type), data_(data), locale_(locale), status_code_(status_code), body_(body) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
 
 				const char* what() const noexcept override {
 					return this->fmt_str_.c_str();
@@ -55,20 +57,43 @@ namespace liboai {
 					return _etype_strs_[static_cast<uint8_t>(type)];
 				}
 
+				EType GetType() const noexcept {
+					return this->error_type_;
+				}
+
+				/*
+					@brief Returns the HTTP status of the response that
+						raised the exception, or 0 if it did not come
+						from a response.
+				*/
+				long GetStatusCode() const noexcept {
+					return this->status_code_;
+				}
+
+				/*
+					@brief Returns the body of the response that raised
+						the exception, empty if it did not come from one.
+				*/
+				const std::string& GetBody() const noexcept {
+					return this->body_;
+				}
+
 			private:
 				EType error_type_;
 				std::string data_, locale_, fmt_str_;
+				long status_code_ = 0;
+				std::string body_;
 		};
 
 		class OpenAIRateLimited : public std::exception {
 			public:
 				OpenAIRateLimited() = default;
 				OpenAIRateLimited(const OpenAIRateLimited& rhs) noexcept
-					: error_type_(rhs.error_type_), data_(rhs.data_), locale_(rhs.locale_) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+					: error_type_(rhs.error_type_), data_(rhs.data_), locale_(rhs.locale_), retry_after_ms_(rhs.retry_after_ms_), body_(rhs.body_) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
 				OpenAIRateLimited(OpenAIRateLimited&& rhs) noexcept
-					: error_type_(rhs.error_type_), data_(std::move(rhs.data_)), locale_(std::move(rhs.locale_)) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
-				OpenAIRateLimited(std::string_view data, EType error_type, std::string_view locale) noexcept
-					: error_type_(error_type), data_(data), locale_(locale) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+					: error_type_(rhs.error_type_), data_(std::move(rhs.data_)), locale_(std::move(rhs.locale_)), retry_after_ms_(rhs.retry_after_ms_), body_(std::move(rhs.body_)) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+				OpenAIRateLimited(std::string_view data, EType error_type, std::string_view locale, long retry_after_ms = -1, std::string_view body = {}) noexcept
+					: error_type_(error_type), data_(data), locale_(locale), retry_after_ms_(retry_after_ms), body_(body) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
 
 				const char* what() const noexcept override {
 					return this->fmt_str_.c_str();
@@ -78,9 +103,27 @@ namespace liboai {
 					return _etype_strs_[static_cast<uint8_t>(type)];
 				}
 
+				/*
+					@brief Returns the delay the server asked for in its
+						Retry-After header in milliseconds, or -1 if the
+						response carried none.
+				*/
+				long GetRetryAfterMs() const noexcept {
+					return this->retry_after_ms_;
+				}
+
+				/*
+					@brief Returns the body of the 429 response.
+				*/
+				const std::string& GetBody() const noexcept {
+					return this->body_;
+				}
+
 			private:
 				EType error_type_;
 				std::string data_, locale_, fmt_str_;
+				long retry_after_ms_ = -1;
+				std::string body_;
 		};
 	}
 }
\ No newline at end of file
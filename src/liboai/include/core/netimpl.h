@@ -43,6 +43,15 @@
 #include <mutex>
 #include <future>
 #include <sstream>
+#include <map>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <cstdlib>
 #include <curl/curl.h>
 #include "response.h"
 
@@ -58,6 +67,111 @@ namespace liboai {
 			void ErrorCheck(CURLFORMcode ecode, std::string_view where);
 		#endif
 
+		/*
+			Receive buffers of a transfer. They travel with the cURL
+			handle through the ConnectionPool, so a handle's buffers
+			keep their capacity from one request to the next. The
+			body is moved out into the Response and replaced by the
+			storage of a destroyed Response when one is recycled;
+			otherwise it is reallocated once, sized from
+			Content-Length when the server sends it.
+		*/
+		struct ResponseBuffers {
+			std::string headers;
+			std::string body;
+
+			void Clear() noexcept {
+				this->headers.clear();
+				this->body.clear();
+			}
+		};
+
+		/*
+			Process-wide pool of reusable cURL easy handles keyed by
+			scheme://host[:port]. A handle checked back in keeps its
+			live keep-alive connections, so the next request to the
+			same host skips the TCP connect and TLS handshake.
+
+			Every handle, pooled or not, is also attached to one
+			process-wide share object holding the DNS cache and TLS
+			session IDs, so resolved hosts and resumable sessions are
+			visible to all handles regardless of which one made them.
+			Connections stay with the handle that opened them.
+		*/
+		class ConnectionPool final {
+			public:
+				struct Stats {
+					uint64_t hits = 0;            // checkouts served by an idle handle
+					uint64_t misses = 0;          // checkouts that created a new handle
+					uint64_t connects = 0;        // new connections opened by transfers
+					uint64_t reused = 0;          // transfers served by a live connection
+					double handshake_ms = 0.0;    // total connect + TLS handshake time
+				};
+
+				ConnectionPool(const ConnectionPool&) = delete;
+				ConnectionPool(ConnectionPool&&) = delete;
+				ConnectionPool& operator=(const ConnectionPool&) = delete;
+				ConnectionPool& operator=(ConnectionPool&&) = delete;
+				~ConnectionPool();
+
+				static ConnectionPool& Instance() noexcept {
+					static ConnectionPool instance;
+					return instance;
+				}
+
+				/*
+					@brief Takes an idle handle for the host of 'url' or
+						creates a new one if none is available. The
+						handle's receive buffers, if any, are moved
+						into 'buffers'.
+				*/
+				CURL* Checkout(const std::string& url, ResponseBuffers* buffers = nullptr);
+
+				/*
+					@brief Returns a handle to the pool. The handle is reset
+						but keeps its connection cache and its cleared
+						receive buffers; handles beyond the per-host idle
+						limit are cleaned up.
+				*/
+				void Checkin(const std::string& key, CURL* handle, ResponseBuffers&& buffers = {});
+
+				/*
+					@brief Records connection reuse and handshake time of the
+						transfer just performed on 'handle'.
+				*/
+				void Record(CURL* handle);
+
+				/*
+					@brief Attaches 'handle' to the process-wide share of
+						DNS and TLS session caches.
+				*/
+				CURLcode Share(CURL* handle) noexcept;
+
+				void SetMaxIdle(size_t max_idle) noexcept;
+				Stats GetStats() const;
+
+				static std::string KeyFromUrl(const std::string& url);
+
+			private:
+				struct Idle {
+					CURL* handle = nullptr;
+					ResponseBuffers buffers;
+				};
+
+				ConnectionPool();
+
+				static void LockShare(CURL*, curl_lock_data data, curl_lock_access, void* userptr);
+				static void UnlockShare(CURL*, curl_lock_data data, void* userptr);
+
+				mutable std::mutex mutex_;
+				std::map<std::string, std::vector<Idle>> idle_;
+				size_t max_idle_ = 8;
+				Stats stats_;
+
+				CURLSH* share_ = nullptr;
+				std::mutex share_locks_[CURL_LOCK_DATA_LAST];
+		};
+
 		class CurlHolder {
 			public:
 				CurlHolder();
@@ -77,8 +191,20 @@ namespace liboai {
 					return g_curl_mutex;
 				}
 
+				static void CheckSSL();
+
 			protected:
+				/*
+					Deferred holder; the handle is checked out of the
+					ConnectionPool once the request url is known.
+				*/
+				explicit CurlHolder(std::nullptr_t);
+
+				void Checkout(const std::string& url);
+
 				CURL* curl_ = nullptr;
+				std::string pool_key_{};
+				ResponseBuffers buffers_{};
 		};
 
 		/*
@@ -296,6 +422,43 @@ namespace liboai {
 					}
 			};
 
+			/*
+				@brief Request body made of shared, immutable parts that are
+					streamed to cURL in order through CURLOPT_READFUNCTION,
+					so no contiguous copy of the body is ever built. Parts
+					are held by shared_ptr so callers can cache them and
+					reuse them across requests.
+			*/
+			class SegmentedBody final {
+				public:
+					using part_t = std::shared_ptr<const std::string>;
+
+					SegmentedBody() = default;
+					SegmentedBody(const SegmentedBody& other) = default;
+					SegmentedBody(SegmentedBody&& old) noexcept = default;
+					SegmentedBody& operator=(const SegmentedBody& other) = default;
+					SegmentedBody& operator=(SegmentedBody&& old) noexcept = default;
+
+					void Append(part_t part) {
+						this->size_ += part->size();
+						this->parts_.push_back(std::move(part));
+					}
+					void Append(std::string part) {
+						this->Append(std::make_shared<const std::string>(std::move(part)));
+					}
+
+					[[nodiscard]] size_t size() const noexcept { return this->size_; }
+					[[nodiscard]] std::string str() const;
+
+					// read cursor, driven by cURL
+					size_t Read(char* buffer, size_t length) noexcept;
+					bool Seek(size_t offset) noexcept;
+
+				private:
+					std::vector<part_t> parts_;
+					size_t size_ = 0, part_ = 0, offset_ = 0;
+			};
+
 			struct Buffer final {
 				using data_t = const unsigned char*;
 
@@ -599,8 +762,79 @@ namespace liboai {
 					intptr_t userdata{};
 					std::function<bool(std::string data, intptr_t userdata)> callback;
 			};
-			size_t writeUserFunction(char* ptr, size_t size, size_t nmemb, const WriteCallback* write);
+
+			/*
+				@brief Shared flag for cancelling a request submitted to
+					the Reactor. Copies share the flag; a default-constructed
+					token never cancels. A cancelled request's future fails
+					with E_CANCELLED, whether it was queued or in flight.
+
+					A token created from a parent is also cancelled with it,
+					while cancelling the token leaves the parent alone.
+			*/
+			class CancelToken final {
+				public:
+					CancelToken() = default;
+
+					static CancelToken Create() {
+						CancelToken token;
+						token.flag_ = std::make_shared<std::atomic<bool>>(false);
+						return token;
+					}
+
+					static CancelToken Create(const CancelToken& parent) {
+						CancelToken token = Create();
+						token.parent_ = parent.flag_;
+						return token;
+					}
+
+					void Cancel() const;
+					[[nodiscard]] bool Cancelled() const noexcept {
+						return (this->flag_ && this->flag_->load()) || (this->parent_ && this->parent_->load());
+					}
+
+					/*
+						@brief Clears the token's own flag for reuse; a
+							cancelled parent still cancels it.
+					*/
+					void Reset() const noexcept {
+						if (this->flag_) {
+							this->flag_->store(false);
+						}
+					}
+
+				private:
+					std::shared_ptr<std::atomic<bool>> flag_, parent_;
+			};
+
+			/*
+				Called on the reactor thread once an asynchronous transfer
+				has finished, with its response or the exception it failed
+				with, right before its future completes. It must return
+				quickly; exceptions it throws are dropped.
+			*/
+			class CompletionHook final {
+				public:
+					CompletionHook() = default;
+					CompletionHook(std::function<void(const liboai::Response* response, std::exception_ptr error)> p_callback)
+						: callback(std::move(p_callback)) {}
+
+					void operator()(const liboai::Response* response, std::exception_ptr error) const noexcept {
+						if (this->callback) {
+							try {
+								this->callback(response, std::move(error));
+							}
+							catch (...) {}
+						}
+					}
+
+					std::function<void(const liboai::Response* response, std::exception_ptr error)> callback;
+			};
+
+			size_t readSegmentsFunction(char* ptr, size_t size, size_t nitems, SegmentedBody* body);
+			int seekSegmentsFunction(SegmentedBody* body, curl_off_t offset, int origin);
 			size_t writeFunction(char* ptr, size_t size, size_t nmemb, std::string* data);
+			size_t headerFunction(char* ptr, size_t size, size_t nmemb, ResponseBuffers* buffers);
 			size_t writeFileFunction(char* ptr, size_t size, size_t nmemb, std::ofstream* file);
 		}
 
@@ -610,14 +844,16 @@ namespace liboai {
 				following schema:
 				
 				1. Create a session object.
-				2. Set the session's options.
+				2. Set the session's options; the Url must come first
+					as it checks the cURL handle out of the
+					ConnectionPool.
 				3. Call the session's X() method where X is the
 					request method (GET, POST, etc.).
 				4. Return the resulting Response object.
 		*/
 		class Session final : private CurlHolder {
 			public:
-				Session() = default;
+				Session() : CurlHolder(nullptr) {}
 				~Session() override;
 
 				liboai::Response Get();
@@ -628,10 +864,14 @@ namespace liboai {
 			private:
 				template <class... _Options>
 				friend void set_options(Session&, _Options&&...);
+				friend class Reactor;
 
 				void Prepare();
 				void PrepareDownloadInternal();
 				CURLcode Perform();
+				CURLcode Stopped(CURLcode result) const noexcept;
+				void RethrowWriteError();
+				static size_t WriteStream(char* ptr, size_t size, size_t nmemb, Session* session);
 				liboai::Response BuildResponseObject();
 				liboai::Response Complete();
 				liboai::Response CompleteDownload();
@@ -641,7 +881,7 @@ namespace liboai {
 				void PrepareDelete();
 				void PrepareDownload(std::ofstream& file);
 
-				void ParseResponseHeader(const std::string& headers, std::string* status_line, std::string* reason);
+				void ParseResponseHeader(const std::string& headers, std::string* status_line, std::string* reason, long* retry_after_ms = nullptr);
 
 				void SetOption(const components::Url& url);
 				void SetUrl(const components::Url& url);
@@ -651,6 +891,9 @@ namespace liboai {
 				void SetOption(components::Body&& body);
 				void SetBody(components::Body&& body);
 
+				void SetOption(components::SegmentedBody&& body);
+				void SetSegmentedBody(components::SegmentedBody&& body);
+
 				void SetOption(const components::Multipart& multipart);
 				void SetMultipart(const components::Multipart& multipart);
 				void SetOption(components::Multipart&& multipart);
@@ -682,6 +925,9 @@ namespace liboai {
 				void SetOption(components::WriteCallback&& write);
 				void SetWriteCallback(components::WriteCallback&& write);
 
+				void SetOption(const components::CancelToken& cancel);
+				void SetOption(components::CompletionHook&& hook);
+
 				long status_code = 0; double elapsed = 0.0;
 				std::string status_line{}, content{}, url_str{}, reason{};
 			
@@ -696,11 +942,14 @@ namespace liboai {
 				#endif
 						
 				bool hasBody = false;
-				std::string parameter_string_, url_,
-					response_string_, header_string_;
+				std::string parameter_string_, url_;
 				components::Proxies proxies_;
 				components::ProxyAuthentication proxyAuth_;
 				components::WriteCallback write_;
+				components::SegmentedBody segments_;
+				components::CancelToken cancel_;
+				components::CompletionHook hook_;
+				std::exception_ptr write_error_;
 		};
 
 		template <class... _Options>
@@ -735,5 +984,108 @@ namespace liboai {
 		void set_options(Session& session, _Options&&... opts) {
 			(session.SetOption(std::forward<_Options>(opts)), ...);
 		}
+
+		/*
+			Single event-loop thread driving every asynchronous transfer
+			through one curl_multi handle. Transfers beyond the concurrency
+			limit wait in a FIFO queue rather than each occupying a thread;
+			the loop completes the FutureResponse of each finished transfer.
+		*/
+		class Reactor final {
+			public:
+				enum class Method : uint8_t {
+					HTTP_GET,     // GET
+					HTTP_POST,    // POST
+					HTTP_DELETE   // DELETE
+				};
+
+				Reactor(const Reactor&) = delete;
+				Reactor(Reactor&&) = delete;
+				Reactor& operator=(const Reactor&) = delete;
+				Reactor& operator=(Reactor&&) = delete;
+				~Reactor();
+
+				static Reactor& Instance() noexcept {
+					static Reactor instance;
+					return instance;
+				}
+
+				/*
+					@brief Queues a prepared session for execution on the
+						event loop.
+
+					@param *session   Session with all options set.
+					@param *method    Request method to perform.
+
+					@returns Future completed with the session's response
+						or the exception raised while building it.
+				*/
+				liboai::FutureResponse Submit(std::unique_ptr<Session> session, Method method);
+
+				/*
+					@brief Sets the maximum number of transfers in flight;
+						0 means unbounded.
+				*/
+				void SetMaxConcurrency(size_t max_concurrency);
+				size_t GetMaxConcurrency() const;
+
+				size_t InFlight() const;
+				size_t Pending() const;
+
+				/*
+					@brief Wakes the event loop to drop the transfers whose
+						CancelToken has been cancelled.
+				*/
+				void Sweep();
+
+			private:
+				Reactor();
+
+				struct Transfer {
+					std::unique_ptr<Session> session;
+					std::promise<liboai::Response> promise;
+				};
+
+				void Run();
+				void Admit();
+				void Finish(CURL* handle, CURLcode result);
+				void DropCancelled();
+
+				// run the session's completion hook, then complete the future
+				static void Resolve(Transfer& transfer, liboai::Response response);
+				static void Reject(Transfer& transfer, std::exception_ptr error);
+
+				CURLM* multi_ = nullptr;
+				std::thread thread_;
+				std::once_flag started_;
+				std::atomic<bool> stop_{ false };
+				std::atomic<bool> sweep_{ false };
+
+				mutable std::mutex mutex_;
+				std::deque<std::unique_ptr<Transfer>> queue_;
+				std::map<CURL*, std::unique_ptr<Transfer>> active_;
+				size_t max_concurrency_ = 16;
+		};
+
+		template <class... _Options>
+		liboai::FutureResponse GetAsync(_Options&&... options) {
+			auto session = std::make_unique<Session>();
+			set_options(*session, std::forward<_Options>(options)...);
+			return Reactor::Instance().Submit(std::move(session), Reactor::Method::HTTP_GET);
+		}
+
+		template <class... _Options>
+		liboai::FutureResponse PostAsync(_Options&&... options) {
+			auto session = std::make_unique<Session>();
+			set_options(*session, std::forward<_Options>(options)...);
+			return Reactor::Instance().Submit(std::move(session), Reactor::Method::HTTP_POST);
+		}
+
+		template <class... _Options>
+		liboai::FutureResponse DeleteAsync(_Options&&... options) {
+			auto session = std::make_unique<Session>();
+			set_options(*session, std::forward<_Options>(options)...);
+			return Reactor::Instance().Submit(std::move(session), Reactor::Method::HTTP_DELETE);
+		}
 	}
 }
@@ -140,6 +140,46 @@ namespace liboai {
 				return res;
 			}
 
+			/*
+				@brief Asynchronous counterpart of Request. The transfer is
+					driven by the shared netimpl::Reactor event loop, so no
+					thread is created per request; the number of transfers
+					in flight is bounded by Reactor::SetMaxConcurrency.
+			*/
+			template <class... _Params,
+				std::enable_if_t<std::conjunction_v<std::negation<std::is_lvalue_reference<_Params>>...>, int> = 0>
+			inline FutureResponse RequestAsync(
+				const Method& http_method,
+				const std::string& root,
+				const std::string& endpoint,
+				const std::string& content_type,
+				std::optional<netimpl::components::Header> headers = std::nullopt,
+				_Params&&... parameters
+			) const {
+				netimpl::components::Header _headers = { { "Content-Type", content_type } };
+				if (headers) {
+					if (headers.value().size() != 0) {
+						for (auto& i : headers.value()) {
+							_headers.insert(std::move(i));
+						}
+					}
+				}
+
+				if constexpr (sizeof...(parameters) > 0) {
+					return Network::AsyncMethodSchema<netimpl::components::Header&&, _Params&&...>::_method[static_cast<uint8_t>(http_method)](
+						netimpl::components::Url { root + endpoint },
+						std::move(_headers),
+						std::forward<_Params>(parameters)...
+					);
+				}
+				else {
+					return Network::AsyncMethodSchema<netimpl::components::Header&&>::_method[static_cast<uint8_t>(http_method)](
+						netimpl::components::Url { root + endpoint },
+						std::move(_headers)
+					);
+				}
+			}
+
 			/*
 				@brief Function to validate the existence and validity of
 					a file located at a provided file path. This is used
@@ -169,5 +209,13 @@ namespace liboai {
 					netimpl::Delete <netimpl::components::Url&&, T...>
 				};
 			};
+
+			template <class... T> struct AsyncMethodSchema {
+				inline static std::function<FutureResponse(netimpl::components::Url&&, T...)> _method[3] = {
+					netimpl::GetAsync    <netimpl::components::Url&&, T...>,
+					netimpl::PostAsync   <netimpl::components::Url&&, T...>,
+					netimpl::DeleteAsync <netimpl::components::Url&&, T...>
+				};
+			};
 	};
 }
@@ -23,6 +23,7 @@
 
 #include <iostream>
 #include <optional>
+#include <string_view>
 #include <future>
 #include <nlohmann/json.hpp>
 #include "exception.h"
@@ -54,7 +55,7 @@ namespace liboai {
 			}
 
 			std::string dump() const {
-				return this->_json.dump(4);
+				return this->_json.dump();
 			}
 
 		private:
@@ -72,11 +73,18 @@ namespace liboai {
 				std::string&& status_line,
 				std::string&& reason,
 				long status_code,
-				double elapsed
+				double elapsed,
+				long retry_after_ms = -1
 			) noexcept(false);
 			
 			Response& operator=(const liboai::Response& other) noexcept;
 			Response& operator=(liboai::Response&& old) noexcept;
+
+			/*
+				@brief Hands the content's storage to the recycled bodies
+					so a later transfer can receive into it.
+			*/
+			~Response();
 			
 			/*
 				@brief Transparent operator[] wrapper to nlohmann::json to
@@ -92,9 +100,32 @@ namespace liboai {
 					pretty printing of the Response object.
 			*/
 			LIBOAI_EXPORT friend std::ostream& operator<<(std::ostream& os, const Response& r);
+
+			/*
+				@brief Returns the content of the first choice's message,
+					read from the JSON parsed at construction. Returns
+					an empty view if the response carries no such message.
+					The view is valid as long as the Response object is.
+			*/
+			LIBOAI_EXPORT std::string_view GetMessageContent() const noexcept;
+
+			/*
+				@brief Returns the 'usage' object of the response, or a null
+					JSON value if the response carries none.
+			*/
+			LIBOAI_EXPORT const nlohmann::json& GetUsage() const noexcept;
+
+			/*
+				@brief Takes an empty string holding the storage of a
+					destroyed Response's content, or a new string if
+					none is kept. Used by transfers to receive the
+					next body without allocating it again.
+			*/
+			LIBOAI_EXPORT static std::string TakeRecycledBody() noexcept;
 			
 		public:
 			long status_code = 0; double elapsed = 0.0;
+			long retry_after_ms = -1; // from Retry-After, -1 if absent
 			std::string status_line{}, content{}, url{}, reason{};
 			nlohmann::json raw_json{};
 
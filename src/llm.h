@@ -3,68 +3,489 @@
 #include "core.h"
 #include "logger.h"
 #include "liboai.h"
+#include "llm_backend.h"
+#include "rate_governor.h"
+#include "hedge_policy.h"
+#include "completion_cache.h"
+#include "semantic_cache.h"
+#include "tokenizer.h"
 
 ///
 /// @brief LLM client
 ///
 class LLM {
 
-    liboai::OpenAI oai;
+    std::shared_ptr<LLMBackend> backend{std::make_shared<OpenAIBackend>()};
     std::string llm_model;
+    bool stream{false};
 
     Logger* logger;
+    RateGovernor* governor;
+    HedgePolicy hedge;
+    CompletionCache cache;
+    SemanticCache semantic;
+
+    /// Stop sequences of every chat completion
+    inline static const std::vector<std::string> stop_sequences{"<<CALL>>"};
 
 public:
+    using CancelToken = LLMBackend::CancelToken;
+
+    /// What a caller brings to a call on an LLM shared between executors
+    struct call_context {
+        Logger* logger;                     /// Log of the caller, the process log if null
+        std::optional<CancelToken> cancel;  /// Cancels the request in flight
+    };
+
+    /// Name of the trailing message with volatile agent state, not part of a turn
+    inline static const std::string state_message_name{"state"};
+
+    ///
+    /// Prompt tokens of a conversation. With a tokenizer vocabulary loaded
+    /// the contents are counted exactly, plus the chat format overhead of
+    /// each message; otherwise estimated from the message serializations.
+    ///
+    static double estimate_tokens(const liboai::Conversation& conversation) {
+        return estimate_tokens(message_tokens(conversation));
+    }
+
+    /// Prompt tokens of a conversation from the tokens of its messages
+    static double estimate_tokens(const std::vector<double>& message_tokens) {
+        double tokens = Tokenizer::get_instance()->loaded() ? 3 : 1;  /// Reply priming
+        for (double message : message_tokens) {
+            tokens += message;
+        }
+        return tokens;
+    }
+
+    /// Prompt tokens of each message, as counted by estimate_tokens
+    static std::vector<double> message_tokens(const liboai::Conversation& conversation) {
+        const Tokenizer* tokenizer = Tokenizer::get_instance();
+        std::vector<double> tokens;
+        if (!tokenizer->loaded()) {
+            for (const auto& message : conversation.GetSerializedMessages()) {
+                tokens.push_back(static_cast<double>(message->size()) / 4.0);
+            }
+            return tokens;
+        }
+        for (const auto& message : conversation.GetJSON()["messages"]) {
+            size_t count = 4;   /// Role and separators
+            if (message.contains("content")) {
+                const json& content = message["content"];
+                count += tokenizer->count(content.is_string() ? content.get_ref<const std::string&>() : content.dump());
+            }
+            if (message.contains("name")) {
+                count += tokenizer->count(message["name"].get_ref<const std::string&>()) + 1;
+            }
+            tokens.push_back(static_cast<double>(count));
+        }
+        return tokens;
+    }
 
     LLM() {
         logger = Logger::get_instance();
+        governor = RateGovernor::get_instance();
     }
 
     void set_model(std::string model) {
         llm_model = model;
     }
 
+    /// Stream completions and stop once the instruction calls are complete
+    void set_stream(bool enabled) {
+        stream = enabled;
+    }
+
     void set_provider(std::string endpoint, std::string key) {
-        bool result = oai.auth.SetKey(key);
-        if (!result) {
-            throw std::runtime_error("Failed to set API key");
+        backend = std::make_shared<OpenAIBackend>(endpoint, key);
+    }
+
+    /// Replace the transport, e.g. with MockBackend for runs without a network
+    void set_backend(std::shared_ptr<LLMBackend> new_backend) {
+        backend = std::move(new_backend);
+    }
+
+    ///
+    /// Chat completion, logged to the caller's log. With a cancel token the
+    /// request goes through the async path, so cancelling ends it in
+    /// flight; a cancelled completion comes back as an empty response.
+    ///
+    liboai::Response chat_completion(liboai::Conversation& conversation, float temperature,
+        const call_context& context = {}) {
+        guard("LLM::chat_completion")
+        Logger* log = context.logger ? context.logger : logger;
+        const std::optional<CancelToken>& cancel = context.cancel;
+        log->log("Call chat_completion");
+        {
+            /// The state message is sent with this call only, never counted as logged
+            const json& messages = conversation.GetJSON()["messages"];
+            size_t kept = messages.size();
+            if (kept && messages.back().value("name", "") == state_message_name) {
+                --kept;
+            }
+            log->log_conversation(messages, conversation.MarkLogged(kept));
+        }
+
+        /// Temperature 0 answers are reproducible, serve them from disk
+        std::string cache_key;
+        if (temperature == 0.0f && cache.enabled()) {
+            cache_key = CompletionCache::key(backend->endpoint(), llm_model, temperature, stop_sequences, stream, conversation);
+            if (auto cached = cache.get(cache_key)) {
+                log->log("Response (cached)");
+                log->log_json(cached->raw_json);
+                return std::move(*cached);
+            }
         }
-        oai.ChatCompletion->SetEndpoint(endpoint);
+
+        double tokens = estimate_tokens(conversation);
+        liboai::Response response;
+        try {
+            response = governor->run(tokens, [&] {
+                if (stream) {
+                    return chat_completion_stream(conversation, temperature, cancel);
+                }
+                if (hedge.enabled()) {
+                    return chat_completion_hedged(conversation, temperature, tokens, context);
+                }
+                if (cancel) {
+                    return backend->chat_completion_async(llm_model, conversation, temperature, stop_sequences, *cancel).get();
+                }
+                return backend->chat_completion(llm_model, conversation, temperature, stop_sequences);
+            });
+        } catch (const liboai::exception::OpenAIException&) {
+            if (!cancel || !cancel->Cancelled()) {
+                throw;
+            }
+            log->log("Cancelled");
+            return liboai::Response();
+        }
+        log->log(stream ? "Response (streamed)" : "Response");
+        log->log_json(response.raw_json);
+        cache_response(cache_key, response);
+        return response;
+        unguard()
+        return liboai::Response();
     }
 
-    liboai::Response chat_completion(liboai::Conversation& conversation, float temperature) {
+    ///
+    /// Completion of a cacheable instruction. The final turn is embedded and
+    /// a close enough turn seen before in the same scope returns its stored
+    /// completion; some hits are still sent to the LLM to count false hits.
+    /// The scope includes a hash of every message but the final turn, the
+    /// trailing state message too, so only turns that follow the same context
+    /// and short-term memory can match.
+    ///
+    liboai::Response chat_completion(liboai::Conversation& conversation, float temperature, const std::string& semantic_scope,
+        const call_context& context = {}) {
         guard("LLM::chat_completion")
-        logger->log("Call chat_completion");
-        logger->log(conversation.GetJSON().dump(4));
-        oai.auth.SetMaxTimeout(120000); /// ms
-        liboai::Response response = oai.ChatCompletion->create(
-            llm_model,              /// model
-            conversation,           /// conversation
-            temperature,            /// temperature
-            std::nullopt,           /// top_p
-            std::nullopt,           /// n
-            std::nullopt,           /// stream
-            std::vector<std::string>{"<<CALL>>"}, /// stop
-            std::nullopt,           /// max_tokens
-            std::nullopt,           /// presence_penalty
-            std::nullopt,           /// frequency_penalty
-            std::nullopt,           /// logit_bias
-            std::nullopt            /// user
-        );
-        response = liboai::Response(response);
-        logger->log("Response");
-        logger->log(json::parse(response.content).dump(4));
+        size_t final_turn = std::string::npos;
+        std::vector<float> turn;
+        if (semantic.enabled()) {
+            final_turn = find_final_turn(conversation);
+            turn = embed_turn(conversation, final_turn);
+        }
+        if (turn.empty()) {
+            return chat_completion(conversation, temperature, context);
+        }
+
+        fnv_hasher scope_hash;
+        const auto& serialized = conversation.GetSerializedMessages();
+        for (size_t i = 0; i < serialized.size(); ++i) {
+            if (i != final_turn) {
+                scope_hash.update(*serialized[i]);
+            }
+        }
+        std::string scope = llm_model + "/" + semantic_scope + "/" + scope_hash.hex();
+
+        auto hit = semantic.lookup(scope, turn);
+        bool sampled = hit && semantic.should_sample();
+        if (hit && !sampled) {
+            semantic.record_hit(*hit);
+            Logger* log = context.logger ? context.logger : logger;
+            log->log(fmt::format("Response (semantic cache, similarity {:.3f})", hit->similarity));
+            log->log_json(hit->completion);
+            return liboai::Response("semantic://" + scope, hit->completion.dump(), "HTTP/1.1 200 OK", "OK", 200, 0.0, -1);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        liboai::Response response = chat_completion(conversation, temperature, context);
+        double latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (context.cancel && context.cancel->Cancelled()) {
+            return response;
+        }
+
+        json stored = response.raw_json;
+        stored.erase("usage");
+        if (sampled) {
+            bool same = same_answer(hit->completion, stored);
+            semantic.record_sample(hit->id, same, std::move(stored));
+        } else {
+            semantic.insert(scope, std::move(turn), std::move(stored), latency_ms);
+        }
         return response;
         unguard()
         return liboai::Response();
     }
 
+    ///
+    /// Streamed variant of chat_completion. Deltas are collected as they
+    /// arrive and the transfer is stopped at <<CALL>>, or once text other
+    /// than another fenced block follows the instruction blocks, so the
+    /// executor can start the tools without waiting for the rest of the
+    /// generation. Several blocks before one <<CALL>> all arrive, for
+    /// fan-out. Returns a response shaped like a regular completion; the
+    /// usage is only known when the stream ran to its end. Cancelling
+    /// stops the transfer at the next chunk.
+    ///
+    liboai::Response chat_completion_stream(liboai::Conversation& conversation, float temperature,
+        const std::optional<CancelToken>& cancel) {
+        liboai::Conversation stream_conversation;
+        std::string content;
+        bool completed = false;
+        size_t calls_end = std::string::npos;   /// End of the last complete instruction block
+
+        auto on_data = [&](std::string data, intptr_t) -> bool {
+            if (cancel && cancel->Cancelled()) {
+                return false;
+            }
+            std::string delta;
+            stream_conversation.AppendStreamData(data, delta, completed);
+            if (delta.empty()) {
+                return true;
+            }
+            size_t scan_from = content.size() > 8 ? content.size() - 8 : 0;
+            content += delta;
+
+            /// Stop sequence, in case the server streams it through
+            size_t call = content.find("<<CALL>>", scan_from);
+            if (call != std::string::npos) {
+                content.resize(call);
+                return false;
+            }
+
+            /// Only a closing fence can complete an instruction block
+            if (delta.find('`') != std::string::npos) {
+                std::vector<std::string> json_blocks = extract_json_blocks(content);
+                if (!get_first_instruction(json_blocks).empty()) {
+                    /// Each block includes its closing fence
+                    calls_end = content.rfind(json_blocks.back()) + json_blocks.back().size();
+                }
+            }
+            if (calls_end == std::string::npos) {
+                return true;
+            }
+            size_t next = content.find_first_not_of(" \t\r\n", calls_end);
+            std::string_view rest = next == std::string::npos ? std::string_view() : std::string_view(content).substr(next);
+            if (rest.starts_with("```") || std::string_view("```").starts_with(rest)) {
+                return true; /// Another block may follow
+            }
+            content.resize(calls_end);
+            return false; /// Stop generation, the calls are complete
+        };
+
+        liboai::Response response = backend->chat_completion(llm_model, conversation, temperature, stop_sequences, on_data);
+        if (cancel && cancel->Cancelled()) {
+            throw liboai::exception::OpenAIException(
+                "Request cancelled",
+                liboai::exception::EType::E_CANCELLED,
+                "LLM::chat_completion_stream()"
+            );
+        }
+
+        json completion = {
+            {"object", "chat.completion"},
+            {"model", llm_model},
+            {"choices", json::array({
+                {
+                    {"index", 0},
+                    {"message", {{"role", "assistant"}, {"content", content}}},
+                    {"finish_reason", completed ? "stop" : "tool_call"}
+                }
+            })}
+        };
+        if (!stream_conversation.GetStreamUsage().is_null()) {
+            completion["usage"] = stream_conversation.GetStreamUsage();
+        }
+        /// Already checked by create(), fill in place instead of re-parsing
+        response.content = completion.dump();
+        response.raw_json = std::move(completion);
+        return response;
+    }
+
+    ///
+    /// Sends the completion through the reactor and, if it is still running
+    /// at the hedge threshold, a duplicate of it. The first good response
+    /// wins and the other request is cancelled.
+    ///
+    liboai::Response chat_completion_hedged(liboai::Conversation& conversation, float temperature, double tokens,
+        const call_context& context) {
+        auto submit = [&](const CancelToken& cancel) {
+            return backend->chat_completion_async(llm_model, conversation, temperature, stop_sequences, cancel);
+        };
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed_ms = [&start] {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        auto threshold = hedge.threshold();
+        /// Each request can be cancelled on its own, and both with the caller's token
+        auto create = [&context] { return context.cancel ? CancelToken::Create(*context.cancel) : CancelToken::Create(); };
+        CancelToken cancels[2] = { create(), create() };
+        std::future<liboai::Response> requests[2];
+        requests[0] = submit(cancels[0]);
+
+        auto not_hedged = [&] {
+            liboai::Response response = requests[0].get();
+            hedge.record(elapsed_ms(), false);
+            return response;
+        };
+        if (!threshold || requests[0].wait_for(*threshold) == std::future_status::ready ||
+            !governor->try_acquire(tokens)) {
+            return not_hedged();
+        }
+        if (!hedge.try_hedge()) {
+            governor->refund(tokens);
+            return not_hedged();
+        }
+
+        (context.logger ? context.logger : logger)->log(fmt::format("Hedging chat_completion after {} ms", threshold->count()));
+        requests[1] = submit(cancels[1]);
+
+        /// A waiter per request wakes this thread once its response is in
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool ready[2] = { false, false };
+        std::thread waiters[2];
+        for (size_t i = 0; i < 2; ++i) {
+            waiters[i] = std::thread([&, i] {
+                requests[i].wait();
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ready[i] = true;
+                }
+                cv.notify_one();
+            });
+        }
+
+        /// First good response wins; a failure waits for the other one
+        bool done[2] = { false, false };
+        std::optional<liboai::Response> response;
+        std::exception_ptr error;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!response && !(done[0] && done[1])) {
+            cv.wait(lock, [&] { return (ready[0] && !done[0]) || (ready[1] && !done[1]); });
+            size_t i = ready[0] && !done[0] ? 0 : 1;
+            done[i] = true;
+            lock.unlock();
+            try {
+                response = requests[i].get();
+                cancels[1 - i].Cancel();
+                hedge.record(elapsed_ms(), i == 1);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lock.lock();
+        }
+        lock.unlock();
+
+        /// The loser was cancelled, so its waiter returns promptly
+        for (auto& waiter : waiters) {
+            waiter.join();
+        }
+        if (!response) {
+            std::rethrow_exception(error);
+        }
+        return std::move(*response);
+    }
+
+    /// Index of the last message that is not the state message, npos if none
+    static size_t find_final_turn(const liboai::Conversation& conversation) {
+        const json& messages = conversation.GetJSON()["messages"];
+        for (size_t i = messages.size(); i > 0; --i) {
+            if (messages[i - 1].value("name", "") != state_message_name) {
+                return i - 1;
+            }
+        }
+        return std::string::npos;
+    }
+
+    /// Embedding of the message, empty if it has no text or the request fails
+    std::vector<float> embed_turn(const liboai::Conversation& conversation, size_t index) {
+        if (index == std::string::npos) {
+            return {};
+        }
+        const json& turn = conversation.GetJSON()["messages"][index];
+        auto content = turn.find("content");
+        if (content == turn.end() || !content->is_string()) {
+            return {};
+        }
+        try {
+            liboai::Response response = embedding(content->get<std::string>());
+            return response["data"][0]["embedding"].get<std::vector<float>>();
+        } catch (const std::exception&) {
+            /// A cache that cannot embed is skipped, never fatal
+            return {};
+        }
+    }
+
+    /// Message contents of a completion, whitespace collapsed and lower-cased
+    static std::string answer_text(const json& completion) {
+        std::string text;
+        for (const auto& choice : completion.value("choices", json::array())) {
+            auto message = choice.find("message");
+            if (message == choice.end() || !message->contains("content") || !(*message)["content"].is_string()) {
+                continue;
+            }
+            for (unsigned char c : (*message)["content"].get_ref<const std::string&>()) {
+                if (std::isspace(c)) {
+                    if (!text.empty() && text.back() != ' ') {
+                        text += ' ';
+                    }
+                } else {
+                    text += static_cast<char>(std::tolower(c));
+                }
+            }
+            text += '\n';
+        }
+        return text;
+    }
+
+    ///
+    /// Whether a fresh answer to a sampled hit agrees with the cached one.
+    /// The fresh call runs at the instruction's temperature, so wording and
+    /// finish reasons vary; the answers agree when their normalized text is
+    /// equal or their embeddings are within the hit threshold.
+    ///
+    bool same_answer(const json& cached, const json& fresh) {
+        std::string a = answer_text(cached);
+        std::string b = answer_text(fresh);
+        if (a == b) {
+            return true;
+        }
+        try {
+            liboai::Response response = embedding_async(std::vector<std::string>{a, b}).get();
+            return semantic.similar(response["data"][0]["embedding"].get<std::vector<float>>(),
+                response["data"][1]["embedding"].get<std::vector<float>>());
+        } catch (const std::exception&) {
+            return false;   /// Unverifiable, counted as differing
+        }
+    }
+
+    /// Stored without usage, a cache hit spends no tokens
+    void cache_response(const std::string& cache_key, const liboai::Response& response) {
+        if (cache_key.empty()) {
+            return;
+        }
+        json stored = response.raw_json;
+        stored.erase("usage");
+        cache.put(cache_key, stored.dump());
+    }
+
     liboai::Response embedding(const std::string& text, embedding_model model = embedding_model::oai_3small) {
         guard("LLM::embedding")
-        liboai::Response response = oai.Embedding->create(
-            fmt::format("{}", model),
-            text
-        );
+        liboai::Response response = governor->run(Tokenizer::get_instance()->count(text), [&] {
+            return backend->embedding(model, text);
+        });
         //json jres = response["data"][0]["embedding"];
         //std::cout << response << "\n\n";
         return response; //vdb::vector({ jres.begin(), jres.end() }, model);
@@ -72,8 +493,85 @@ public:
         return liboai::Response();
     }
 
+    ///
+    /// Driven by the shared curl-multi reactor, no thread per request.
+    /// Waits for rate budget before submitting; a 429 is retried through
+    /// the blocking path on the thread that collects the result.
+    ///
     std::future<liboai::Response> embedding_async(const std::string& text, embedding_model model = embedding_model::oai_3small) {
-        return std::async(std::launch::async, &LLM::embedding, this, text, model);
+        return submit_embedding(text, Tokenizer::get_instance()->count(text), model);
+    }
+
+    /// Several inputs in one request, data[i] holds the embedding of texts[i]
+    std::future<liboai::Response> embedding_async(const std::vector<std::string>& texts, embedding_model model = embedding_model::oai_3small) {
+        size_t tokens = 0;
+        for (const auto& text : texts) {
+            tokens += Tokenizer::get_instance()->count(text);
+        }
+        return submit_embedding(texts, static_cast<double>(tokens), model);
+    }
+
+private:
+    template <typename Input>
+    std::future<liboai::Response> submit_embedding(const Input& input, double tokens, embedding_model model) {
+        governor->acquire(tokens, false);
+        auto response = backend->embedding_async(model, input);
+        return std::async(std::launch::deferred,
+            [this, tokens, input, model, response = std::move(response)]() mutable {
+                try {
+                    liboai::Response result = response.get();
+                    governor->on_success(tokens, RateGovernor::usage_tokens(result, tokens));
+                    return result;
+                } catch (const liboai::exception::OpenAIRateLimited& e) {
+                    governor->on_throttled(e.GetRetryAfterMs());
+                    if (!governor->should_retry(0)) {
+                        throw;
+                    }
+                    std::this_thread::sleep_for(governor->backoff(0, e.GetRetryAfterMs()));
+                    return governor->run(tokens, [&] {
+                        return backend->embedding(model, input);
+                    }, 1);
+                }
+            }
+        );
+    }
+
+public:
+    /// Upper bound of requests in flight, the AIMD window never exceeds it
+    void set_max_concurrency(size_t max_concurrency) {
+        governor->set_max_concurrency(max_concurrency);
+    }
+
+    /// Hedge at this percentile of recent latency (0 disables), capped to a fraction of requests
+    void set_hedging(double percentile, double max_fraction) {
+        hedge.configure(percentile, max_fraction);
+    }
+
+    HedgePolicy::stats get_hedge_stats() {
+        return hedge.get_stats();
+    }
+
+    /// Directory of the temperature-0 completion cache (empty disables), bounded to max_bytes
+    void set_completion_cache(const std::string& directory, uintmax_t max_bytes) {
+        cache.configure(directory, max_bytes);
+    }
+
+    CompletionCache::stats get_cache_stats() {
+        return cache.get_stats();
+    }
+
+    /// Similarity for a semantic cache hit (0 disables), share of hits re-checked against the LLM
+    void set_semantic_cache(double threshold, double sample_rate) {
+        semantic.configure(threshold, sample_rate);
+    }
+
+    SemanticCache::stats get_semantic_cache_stats() {
+        return semantic.get_stats();
+    }
+
+    /// Requests and tokens per minute (0 is unlimited), retries per 429
+    void set_rate_limits(double rpm, double tpm, int max_retries) {
+        governor->set_limits(rpm, tpm, max_retries);
     }
 
     /// TODO: Refine
@@ -85,15 +583,7 @@ public:
             "\n\nRESULT: " + data
         );
         liboai::Response response = chat_completion(working_memory, 0.5);
-        json content = json::parse(std::string(response.content));
-        if (content.contains("choices")) { /// Top level, several messages
-            for (auto& choice : content["choices"].items()) {
-                if (choice.value().contains("message")) {
-                    json message = choice.value()["message"];
-                    result = std::string(message["content"]);
-                }
-            }
-        }
+        result = response.GetMessageContent();
         return result;
     }
 
@@ -107,15 +597,7 @@ public:
             json_content
         );
         liboai::Response response = chat_completion(working_memory, 0.5);
-        json content = json::parse(std::string(response.content));
-        if (content.contains("choices")) { /// Top level, several messages
-            for (auto& choice : content["choices"].items()) {
-                if (choice.value().contains("message")) {
-                    json message = choice.value()["message"];
-                    result = std::string(message["content"]);
-                }
-            }
-        }
+        result = response.GetMessageContent();
         return result;
     }
 
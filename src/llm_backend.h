@@ -0,0 +1,146 @@
+#pragma once
+
+#include "core.h"
+#include "liboai.h"
+
+///
+/// @brief Transport behind LLM
+///
+/// LLM keeps caching, rate limiting and hedging; a backend only turns a
+/// request into a response. Responses are shaped like the OpenAI API, so
+/// the executor cannot tell the backends apart.
+///
+class LLMBackend {
+public:
+    using StreamCallback = std::function<bool(std::string, intptr_t)>;
+    using CancelToken = liboai::netimpl::components::CancelToken;
+    using CompletionHook = liboai::netimpl::components::CompletionHook;
+
+    virtual ~LLMBackend() = default;
+
+    /// Where completions come from, e.g. the endpoint URL; caches keep the
+    /// completions of different sources apart by it
+    virtual std::string endpoint() = 0;
+
+    /// Blocking completion; with a stream callback the raw SSE chunks go to it
+    /// and returning false from it stops the generation
+    virtual liboai::Response chat_completion(const std::string& model, const liboai::Conversation& conversation,
+        float temperature, const std::vector<std::string>& stop, std::optional<StreamCallback> stream = std::nullopt) = 0;
+
+    /// Completion in flight; a cancelled token fails the future. The hook
+    /// sees the outcome on the completing thread, before the future is ready
+    virtual std::future<liboai::Response> chat_completion_async(const std::string& model, const liboai::Conversation& conversation,
+        float temperature, const std::vector<std::string>& stop, CancelToken cancel, CompletionHook hook = {}) = 0;
+
+    virtual liboai::Response embedding(embedding_model model, const std::string& text) = 0;
+    virtual liboai::Response embedding(embedding_model model, const std::vector<std::string>& texts) = 0;
+    virtual std::future<liboai::Response> embedding_async(embedding_model model, const std::string& text, CompletionHook hook = {}) = 0;
+    virtual std::future<liboai::Response> embedding_async(embedding_model model, const std::vector<std::string>& texts, CompletionHook hook = {}) = 0;
+
+protected:
+    /// Runs a simulated request and reports its outcome to the hook, as the reactor does
+    template <typename Request>
+    static liboai::Response completing(const CompletionHook& hook, Request&& request) {
+        try {
+            liboai::Response response = request();
+            hook(&response, nullptr);
+            return response;
+        } catch (...) {
+            hook(nullptr, std::current_exception());
+            throw;
+        }
+    }
+
+    /// Simulated latency, slept in slices so a cancelled request ends early
+    static void wait(std::chrono::microseconds duration, const CancelToken& cancel) {
+        auto deadline = std::chrono::steady_clock::now() + duration;
+        while (std::chrono::steady_clock::now() < deadline) {
+            if (cancel.Cancelled()) {
+                throw liboai::exception::OpenAIException(
+                    "Request cancelled",
+                    liboai::exception::EType::E_CANCELLED,
+                    "LLMBackend::wait()"
+                );
+            }
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+                deadline - std::chrono::steady_clock::now(), std::chrono::milliseconds(5)));
+        }
+    }
+};
+
+///
+/// @brief OpenAI compatible HTTP endpoint through liboai
+///
+class OpenAIBackend : public LLMBackend {
+    liboai::OpenAI oai;
+    std::string url{"https://api.openai.com/v1"};
+
+public:
+    OpenAIBackend() = default;
+
+    OpenAIBackend(const std::string& endpoint, const std::string& key) : url(endpoint) {
+        if (!oai.auth.SetKey(key)) {
+            throw std::runtime_error("Failed to set API key");
+        }
+        oai.auth.SetMaxTimeout(120000); /// ms
+        oai.ChatCompletion->SetEndpoint(endpoint);
+    }
+
+    std::string endpoint() override {
+        return url;
+    }
+
+    liboai::Response chat_completion(const std::string& model, const liboai::Conversation& conversation,
+        float temperature, const std::vector<std::string>& stop, std::optional<StreamCallback> stream = std::nullopt) override {
+        return oai.ChatCompletion->create(
+            model,                  /// model
+            conversation,           /// conversation
+            temperature,            /// temperature
+            std::nullopt,           /// top_p
+            std::nullopt,           /// n
+            std::move(stream),      /// stream
+            stop,                   /// stop
+            std::nullopt,           /// max_tokens
+            std::nullopt,           /// presence_penalty
+            std::nullopt,           /// frequency_penalty
+            std::nullopt,           /// logit_bias
+            std::nullopt            /// user
+        );
+    }
+
+    std::future<liboai::Response> chat_completion_async(const std::string& model, const liboai::Conversation& conversation,
+        float temperature, const std::vector<std::string>& stop, CancelToken cancel, CompletionHook hook = {}) override {
+        return oai.ChatCompletion->create_async(
+            model,                  /// model
+            conversation,           /// conversation
+            temperature,            /// temperature
+            std::nullopt,           /// top_p
+            std::nullopt,           /// n
+            std::nullopt,           /// stream
+            stop,                   /// stop
+            std::nullopt,           /// max_tokens
+            std::nullopt,           /// presence_penalty
+            std::nullopt,           /// frequency_penalty
+            std::nullopt,           /// logit_bias
+            std::nullopt,           /// user
+            std::move(cancel),      /// cancel
+            std::move(hook)         /// hook
+        );
+    }
+
+    liboai::Response embedding(embedding_model model, const std::string& text) override {
+        return oai.Embedding->create(fmt::format("{}", model), text);
+    }
+
+    liboai::Response embedding(embedding_model model, const std::vector<std::string>& texts) override {
+        return oai.Embedding->create(fmt::format("{}", model), texts);
+    }
+
+    std::future<liboai::Response> embedding_async(embedding_model model, const std::string& text, CompletionHook hook = {}) override {
+        return oai.Embedding->create_async(fmt::format("{}", model), text, std::nullopt, std::move(hook));
+    }
+
+    std::future<liboai::Response> embedding_async(embedding_model model, const std::vector<std::string>& texts, CompletionHook hook = {}) override {
+        return oai.Embedding->create_async(fmt::format("{}", model), texts, std::nullopt, std::move(hook));
+    }
+};
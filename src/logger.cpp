@@ -11,6 +11,7 @@ Logger::Logger(const std::string& directory) {
     if (!logfile.is_open()) {
         throw std::runtime_error("Unable to open log file: " + filename);
     }
+    writer = std::thread(&Logger::write_loop, this);
 }
 
 /// Function to generate filename with timestamp
@@ -25,13 +26,64 @@ std::string Logger::generate_filename(const std::string& directory) {
 }
 
 Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
     if (logfile.is_open()) {
         logfile.close();
     }
 }
 
-void Logger::log(const std::string& message) {
-    logfile << message << std::endl;
-    logfile.flush();
+void Logger::log(std::string message) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queue.emplace_back(std::move(message));
+    }
+    queue_cv.notify_one();
+}
+
+void Logger::log_json(json message) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queue.emplace_back(std::move(message));
+    }
+    queue_cv.notify_one();
 }
 
+void Logger::log_conversation(const json& messages, size_t logged) {
+    json fresh = json::array();
+    for (size_t i = logged; i < messages.size(); ++i) {
+        fresh.push_back(messages[i]);
+    }
+    log(fmt::format("Conversation: {} messages, {} logged before", messages.size(), logged));
+    log_json(std::move(fresh));
+}
+
+/// Drains the queue in batches, one flush per batch
+void Logger::write_loop() {
+    std::deque<std::variant<std::string, json>> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return; /// Stopping and everything is written
+            }
+            batch.swap(queue);
+        }
+        for (auto& message : batch) {
+            if (auto* text = std::get_if<std::string>(&message)) {
+                logfile << *text << '\n';
+            } else {
+                logfile << std::get<json>(message).dump(4) << '\n';
+            }
+        }
+        logfile.flush();
+        batch.clear();
+    }
+}
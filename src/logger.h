@@ -2,17 +2,28 @@
 
 #include "core.h"
 
+#include <variant>
+#include <condition_variable>
+
 class Logger {
 private:
     std::ofstream logfile;
     static std::unique_ptr<Logger> instance;
     static std::mutex mutex;
 
-    Logger(const std::string& directory);
+    /// Deferred writer, messages are formatted and written off the caller's thread
+    std::deque<std::variant<std::string, json>> queue;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    bool stopping{false};
+    std::thread writer;
 
     std::string generate_filename(const std::string& directory);
+    void write_loop();
 
 public:
+    /// Own log file in the directory, for sessions that must not share the process log
+    explicit Logger(const std::string& directory);
     Logger(const Logger&) = delete;
     Logger(Logger&&) = delete;
     Logger& operator=(const Logger&) = delete;
@@ -27,6 +38,14 @@ public:
         return instance.get();
     }
 
-    void log(const std::string& message);
+    void log(std::string message);
+    /// Dumped on the writer thread, callers never serialize for logging
+    void log_json(json message);
+    ///
+    /// Logs the messages of a conversation from index 'logged' on, so a
+    /// growing conversation costs its new messages on each call instead of
+    /// a copy of all of them. The conversation keeps the count, see
+    /// liboai::Conversation::MarkLogged.
+    ///
+    void log_conversation(const json& messages, size_t logged);
 };
-
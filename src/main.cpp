@@ -9,22 +9,207 @@
 #include "context.h"
 //#include "memory_controller.h"
 #include "agent_executor.h"
+#include "agent_runtime.h"
+#include "agent_server.h"
+#include "genc_file.h"
+#include "mock_backend.h"
+#include "trace_backend.h"
 
 #include "pdffile.h"
 
+#include <csignal>
+
 bool debug{false};
+bool compile_only{false};
 std::atomic<bool> spinner_active{false};
 std::thread spinner_thread;
 std::string completion_text;
 
 int mem_total_tokens{0};
 
+/// Executor of the running agent and the server, for the interrupt handler
+static AgentExecutor* running_executor{nullptr};
+static AgentServer* running_server{nullptr};
+
+/// First Ctrl+C cancels the LLM call in flight and ends the run, a second one exits
+static void on_interrupt(int) {
+    if (running_executor) {
+        running_executor->interrupt();
+    }
+    if (running_server) {
+        running_server->stop();
+    }
+    std::signal(SIGINT, SIG_DFL);
+}
+
+static void install_interrupt_handler() {
+    /// The handler cancels through the reactor, which must not be created inside it
+    liboai::netimpl::Reactor::Instance();
+    std::signal(SIGINT, on_interrupt);
+}
+
+/// Agent instructions and the compiled artifact they came from or go to
+struct agent_source {
+    std::string compiled_path;
+    uint64_t source_key{0};
+    std::map<std::string, Instruction> instructions;
+    std::optional<size_t> compiled_descriptions;    /// Set when loaded from the artifact
+};
+
+///
+/// Loads an agent into the executor from its compiled artifact, valid while
+/// the agent file, tools, model and backend are unchanged, or by parsing the
+/// agent file. The backend is part of the key so descriptions written by a
+/// mock or replay run are never served to a real one. {{input}} stays in the prompts for each run to fill with
+/// render_instructions, so one artifact serves every input.
+///
+static agent_source load_agent(AgentExecutor& executor, const std::string& filename,
+    const std::string& model, const std::string& backend, bool use_compiled) {
+    agent_source source;
+    source.compiled_path = GencFile::artifact_path(filename);
+    source.source_key = GencFile::source_key({
+        read_file(filename), read_file("native_tools.toml"), model, backend
+    });
+    auto compiled = use_compiled ? GencFile::load(source.compiled_path, source.source_key) : std::nullopt;
+
+    if (compiled) {
+        Logger::get_instance()->log("Loaded compiled agent " + source.compiled_path);
+        if (!executor.init_native_tools_json(std::move(compiled->native_tools))) {
+            throw std::runtime_error("Failed to init native tools");
+        }
+        source.instructions = std::move(compiled->instructions);
+        source.compiled_descriptions = compiled->descriptions.size();
+        executor.init_agent(source.instructions, std::move(compiled->descriptions));
+        return source;
+    }
+
+    /// Init native tools
+    if (!executor.init_native_tools("native_tools.toml")) {
+        throw std::runtime_error("Failed to init native tools");
+    }
+
+    /// Load agent file
+    GenFile gen;
+    std::map<std::string, std::string> variables;
+    std::tie(variables, source.instructions) = gen.load_from_file(filename);
+
+    /// Render variables
+    /// TODO: Move into GenFile class
+    for (auto& [key, value] : source.instructions) {
+        value.prompt = render_template(value.prompt, variables);
+    }
+
+    /// Init agent
+    executor.init_agent(source.instructions);
+    return source;
+}
+
+/// Descriptions come from the prompts before {{input}} is filled, so the
+/// artifact holds nothing of any one input; written unless nothing was added
+static void save_agent(const agent_source& source, const AgentExecutor& executor) {
+    if (source.compiled_descriptions && executor.get_agent_instructions().size() == *source.compiled_descriptions) {
+        return;
+    }
+    if (!GencFile::save(source.compiled_path, source.source_key, {
+        source.instructions,
+        executor.get_agent_instructions(),
+        executor.get_native_instructions()
+    })) {
+        Logger::get_instance()->log("Failed to write compiled agent " + source.compiled_path);
+    }
+}
+
+///
+/// Runs the agent once per line of the batch input on a session runtime.
+/// A line is {"id": ..., "input": ...}, a JSON string or plain text; ids
+/// default to the line number. Results are written as they complete, in
+/// completion order, and at most twice the concurrency lines are read ahead.
+/// Totals go to the executor's stats.
+///
+static void run_batch(std::shared_ptr<AgentExecutor> agent_executor, const batch_options& batch,
+    const std::string& workspace_root) {
+    std::ifstream in(batch.input_file);
+    if (!in) {
+        throw std::runtime_error("Failed to open batch input " + batch.input_file);
+    }
+    std::ofstream out(batch.output_file, std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Failed to open batch output " + batch.output_file);
+    }
+    std::mutex out_mutex;
+    std::condition_variable done_cv;
+    size_t in_flight = 0, completed = 0, failed = 0;
+    const size_t max_in_flight = static_cast<size_t>(batch.concurrency) * 2;
+    auto start = std::chrono::steady_clock::now();
+    {
+        AgentRuntime runtime(agent_executor, static_cast<size_t>(batch.concurrency), workspace_root);
+        auto on_done = [&](const AgentRuntime::session_result& result) {
+            json record = {
+                {"id", result.id},
+                {"output", result.output},
+                {"nlop", result.nlop},
+                {"usage", result.usage},
+                {"latency_ms", std::round(result.time_ms)}
+            };
+            if (!result.error.empty()) {
+                record["error"] = result.error;
+            }
+            if (result.interrupted) {
+                record["interrupted"] = true;
+            }
+            std::lock_guard<std::mutex> lock(out_mutex);
+            out << record.dump() << '\n' << std::flush;
+            (result.error.empty() ? completed : failed)++;
+            agent_executor->nlop += result.nlop;
+            agent_executor->usage = accumulate_values(agent_executor->usage, result.usage);
+            agent_executor->prefix_cache.hit_calls += result.prefix_cache.hit_calls;
+            agent_executor->prefix_cache.hit_time += result.prefix_cache.hit_time;
+            agent_executor->prefix_cache.miss_calls += result.prefix_cache.miss_calls;
+            agent_executor->prefix_cache.miss_time += result.prefix_cache.miss_time;
+            in_flight--;
+            done_cv.notify_one();
+        };
+        std::string line;
+        size_t line_number = 0;
+        while (!agent_executor->was_interrupted() && std::getline(in, line)) {
+            line_number++;
+            if (trim(line).empty()) {
+                continue;
+            }
+            std::string id = std::to_string(line_number), input = line;
+            json item = json::parse(line, nullptr, false);
+            if (item.is_object()) {
+                if (item.contains("id")) {
+                    id = item["id"].is_string() ? item["id"].get<std::string>() : item["id"].dump();
+                }
+                input = !item.contains("input") ? "" :
+                    item["input"].is_string() ? item["input"].get<std::string>() : item["input"].dump();
+            } else if (item.is_string()) {
+                input = item.get<std::string>();
+            }
+            {
+                std::unique_lock<std::mutex> lock(out_mutex);
+                done_cv.wait(lock, [&] { return in_flight < max_in_flight; });
+                in_flight++;
+            }
+            runtime.submit({"root", input, id, nullptr, on_done, nullptr});
+        }
+    }   /// The runtime finishes every submitted line before it goes
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    agent_executor->total_time = static_cast<long long>(wall * 1e6);
+    agent_executor->toks = wall > 0 ? static_cast<int>(agent_executor->usage.value("completion_tokens", 0) / wall) : 0;
+    agent_executor->nlops = wall > 0 ? agent_executor->nlop / wall : 0;
+    fmt::print("{}Batch: {} done, {} failed in {:.1f} s ({:.2f} items/s), results in {}\n{}",
+        GREEN, completed, failed, wall, wall > 0 ? (completed + failed) / wall : 0.0, batch.output_file, RESET);
+}
+
 
 int main(int argc, char *argv[]) {
 
     guard("Mentals")
 
-    std::string input, filename = parse_input(argc, argv, input);
+    batch_options batch;
+    std::string input, filename = parse_input(argc, argv, input, batch);
 
     Logger* logger = Logger::get_instance();
     logger->log("Mentals started");
@@ -35,9 +220,31 @@ int main(int argc, char *argv[]) {
 
     /// Load config
     auto config     = toml::parse_file("config.toml");
+    auto backend    = config["llm"]["backend"].value_or<std::string>("openai");
     auto endpoint   = config["llm"]["endpoint"].value_or<std::string>("");
     auto api_key    = config["llm"]["api_key"].value_or<std::string>("");
     auto model      = config["llm"]["model"].value_or<std::string>("");
+    auto max_concurrency = config["llm"]["max_concurrency"].value_or<int64_t>(16);
+    auto stream     = config["llm"]["stream"].value_or<bool>(false);
+    auto rpm        = config["llm"]["rpm"].value_or<double>(0);
+    auto tpm        = config["llm"]["tpm"].value_or<double>(0);
+    auto max_retries = config["llm"]["max_retries"].value_or<int64_t>(5);
+    auto hedge_percentile = config["llm"]["hedge_percentile"].value_or<double>(0);
+    auto hedge_max_fraction = config["llm"]["hedge_max_fraction"].value_or<double>(0.05);
+    auto cache_dir  = config["llm"]["cache_dir"].value_or<std::string>(".cache/completions");
+    auto cache_max_mb = config["llm"]["cache_max_mb"].value_or<int64_t>(64);
+    auto semantic_threshold = config["llm"]["semantic_cache_threshold"].value_or<double>(0);
+    auto semantic_sample = config["llm"]["semantic_cache_sample"].value_or<double>(0.05);
+    auto stable_prompt_prefix = config["llm"]["stable_prompt_prefix"].value_or<bool>(false);
+    auto tokenizer  = config["llm"]["tokenizer"].value_or<std::string>("cl100k_base");
+    auto tokenizer_vocab = config["llm"]["tokenizer_vocab"].value_or<std::string>("");
+    auto max_context_tokens = config["llm"]["max_context_tokens"].value_or<int64_t>(0);
+    auto max_branches = config["llm"]["max_branches"].value_or<int64_t>(8);
+    auto max_nlop   = config["llm"]["max_nlop"].value_or<int64_t>(0);
+    auto trace      = config["llm"]["trace"].value_or<std::string>("");
+    auto trace_mode = config["llm"]["trace_mode"].value_or<std::string>("record");
+    auto trace_latency_scale = config["llm"]["trace_latency_scale"].value_or<double>(1.0);
+    auto batch_workspace = config["batch"]["workspace"].value_or<std::string>("sessions");
     auto dbname     = config["vdb"]["dbname"].value_or<std::string>("memory");
     auto user       = config["vdb"]["user"].value_or<std::string>("postgres");
     auto password   = config["vdb"]["password"].value_or<std::string>("postgres");
@@ -56,51 +263,180 @@ int main(int argc, char *argv[]) {
         );
     }
 
+    /// Exact token counts, loaded before any thread counts tokens
+    if (!tokenizer_vocab.empty()) {
+        Tokenizer::get_instance()->load(tokenizer_vocab, tokenizer);
+    }
+
     /// Init central executive
     ///auto agent_executor = std::make_shared<AgentExecutor>(conn);
     auto agent_executor = std::make_shared<AgentExecutor>();
 
-    agent_executor->llm.set_provider(endpoint, api_key);
+    std::shared_ptr<LLMBackend> llm_backend;
+    std::shared_ptr<RecordingBackend> recorder;
+    std::shared_ptr<ReplayBackend> replay;
+    if (!trace.empty() && trace_mode == "replay") {
+        /// Recorded responses stand in for the configured backend
+        replay = std::make_shared<ReplayBackend>(trace, trace_latency_scale);
+        llm_backend = replay;
+    } else if (backend == "mock") {
+        /// Scripted responses without a network, for measuring the executor itself
+        auto mock = std::make_shared<MockBackend>();
+        auto script = config["mock"]["script"].value_or<std::string>("");
+        if (!script.empty()) {
+            mock->load_script(script);
+        }
+        mock->set_latency(
+            MockBackend::latency::parse(
+                config["mock"]["latency"].value_or<std::string>("fixed"),
+                config["mock"]["latency_ms"].value_or<double>(0),
+                config["mock"]["latency_spread_ms"].value_or<double>(0)),
+            MockBackend::latency::parse("fixed",
+                config["mock"]["embedding_latency_ms"].value_or<double>(0), 0)
+        );
+        mock->set_seed(static_cast<uint64_t>(config["mock"]["seed"].value_or<int64_t>(0)));
+        llm_backend = mock;
+    } else if (backend == "openai") {
+        llm_backend = std::make_shared<OpenAIBackend>(endpoint, api_key);
+    } else {
+        throw std::runtime_error("Unknown LLM backend '" + backend + "'");
+    }
+    if (!trace.empty() && trace_mode == "record") {
+        recorder = std::make_shared<RecordingBackend>(llm_backend, trace);
+        llm_backend = recorder;
+    } else if (!trace.empty() && trace_mode != "replay") {
+        throw std::runtime_error("Unknown trace mode '" + trace_mode + "'");
+    }
+    agent_executor->llm.set_backend(llm_backend);
     agent_executor->llm.set_model(model);
+    /// Compiled descriptions come from this backend, so it keys the artifact
+    auto backend_source = (replay ? std::string("replay") : backend) + " " + llm_backend->endpoint();
+    agent_executor->llm.set_max_concurrency(static_cast<size_t>(max_concurrency));
+    agent_executor->llm.set_stream(stream);
+    agent_executor->llm.set_rate_limits(rpm, tpm, static_cast<int>(max_retries));
+    agent_executor->llm.set_hedging(hedge_percentile, hedge_max_fraction);
+    agent_executor->llm.set_completion_cache(cache_dir, static_cast<uintmax_t>(std::max<int64_t>(cache_max_mb, 0)) << 20);
+    agent_executor->llm.set_semantic_cache(semantic_threshold, semantic_sample);
+    agent_executor->set_stable_prompt_prefix(stable_prompt_prefix);
+    agent_executor->set_max_context_tokens(static_cast<size_t>(std::max<int64_t>(max_context_tokens, 0)));
+    agent_executor->set_max_branches(static_cast<size_t>(std::max<int64_t>(max_branches, 0)));
     /// Set central executive state variables
     agent_executor->set_state_variable("current_date", get_current_date());
     agent_executor->set_state_variable("platform_info", platform_info);
 
-    /// Init native tools
-    if (!agent_executor->init_native_tools("native_tools.toml")) {
-        throw std::runtime_error("Failed to init native tools");
+    /// NLOP limit checked between steps
+    if (max_nlop > 0) {
+        agent_executor->set_step_hook([max_nlop](const AgentExecutor&, int nlop, const std::string&) {
+            return nlop < max_nlop;
+        });
     }
 
-    /// Load agent file
-    GenFile gen;
-    auto [variables, instructions] = gen.load_from_file(filename);
+    if (filename == "serve") {
+        /// Agents are forks of this executor, sharing its LLM and Python environment
+        std::map<std::string, Instruction> no_instructions;
+        agent_executor->init_agent(no_instructions);
+        AgentServer::options options;
+        options.host = config["serve"]["host"].value_or<std::string>("127.0.0.1");
+        options.port = static_cast<int>(config["serve"]["port"].value_or<int64_t>(8080));
+        options.socket = config["serve"]["socket"].value_or<std::string>("mentals.sock");
+        options.token = config["serve"]["token"].value_or<std::string>("");
+        options.max_sessions = static_cast<size_t>(std::max<int64_t>(config["serve"]["max_sessions"].value_or<int64_t>(8), 1));
+        options.max_queue = static_cast<size_t>(std::max<int64_t>(config["serve"]["max_queue"].value_or<int64_t>(64), 0));
+        options.workspace = config["serve"]["workspace"].value_or<std::string>("sessions");
+        AgentServer server(agent_executor, [&](const std::string& agent_file) {
+            auto agent = agent_executor->fork();
+            agent_source source = load_agent(*agent, agent_file, model, backend_source, true);
+            agent->describe_all_instructions();
+            save_agent(source, *agent);
+            return agent;
+        }, options);
+        running_executor = agent_executor.get();
+        running_server = &server;
+        install_interrupt_handler();
+        server.run();
+        std::signal(SIGINT, SIG_DFL);
+        running_server = nullptr;
+        running_executor = nullptr;
+        exit(EXIT_SUCCESS);
+    }
 
-    /// Render variables
-    /// TODO: Move into GenFile class
-    variables["input"] = input;
-    for (auto& [key, value] : instructions) {
-        value.prompt = render_template(value.prompt, variables);
+    agent_source source = load_agent(*agent_executor, filename, model, backend_source, !compile_only);
+    /// Compiling and batch sessions describe everything up front; a single
+    /// run describes an instruction the first time it is offered
+    if (compile_only || !batch.input_file.empty()) {
+        agent_executor->describe_all_instructions();
+        save_agent(source, *agent_executor);
     }
 
-    /// Init agent
-    agent_executor->init_agent(instructions);
+    if (compile_only) {
+        fmt::print("{}Compiled {}\n{}", GREEN, source.compiled_path, RESET);
+        exit(EXIT_SUCCESS);
+    }
 
-    /// Run agent from root instruction
-    agent_executor->run_agent_thread("root", input);
+    running_executor = agent_executor.get();
+    install_interrupt_handler();
+
+    if (!batch.input_file.empty()) {
+        run_batch(agent_executor, batch, batch_workspace);
+    } else {
+        /// Run agent from root instruction
+        agent_executor->render_instructions({{"input", input}});
+        agent_executor->run_agent_thread("root", input);
+        /// Keeps the descriptions this run needed for the next one
+        save_agent(source, *agent_executor);
+    }
+    std::signal(SIGINT, SIG_DFL);
+    running_executor = nullptr;
+    if (agent_executor->was_interrupted()) {
+        fmt::print("{}Interrupted after {} NLOP\n{}", YELLOW, agent_executor->nlop, RESET);
+    }
 
     /// Final stat
+    auto pool = liboai::netimpl::ConnectionPool::Instance().GetStats();
+    auto rate = RateGovernor::get_instance()->get_stats();
+    auto hedge = agent_executor->llm.get_hedge_stats();
+    auto cache = agent_executor->llm.get_cache_stats();
+    auto semantic = agent_executor->llm.get_semantic_cache_stats();
+    auto& prefix = agent_executor->prefix_cache;
+    int prompt_tokens = agent_executor->usage.value("prompt_tokens", 0);
+    int cached_tokens = agent_executor->usage.value("cached_tokens", 0);
     fmt::print(
         "{}--------------------------------------------\n"
         "Tok/s: {} (completion tokens / total time)\n"
         "Completion tokens: {}\n"
         "Total tokens: {}\n"
         "Total NLOP: {}\n"
-        "NLOPS: {:.2f}\n",
+        "NLOPS: {:.2f}\n"
+        "Connections: {} new, {} reused (pool hits: {}, misses: {})\n"
+        "Handshake time: {:.1f} ms\n"
+        "Throttled: {} (retries: {}, failed: {}), budget wait: {:.1f} ms, max queue depth: {}, concurrency: {:.1f}\n"
+        "Hedged: {} of {} requests, {} won (trigger: {:.0f} ms)\n"
+        "Completion cache: {} hits, {} misses, {} evicted ({:.1f} MB)\n"
+        "Semantic cache: {} of {} lookups hit, {:.0f} ms saved, {} false of {} sampled\n"
+        "Prompt cache: {} of {} prompt tokens cached ({:.1f}%), avg latency {:.0f} ms with hits, {:.0f} ms without\n",
         RESET, agent_executor->toks,
-        agent_executor->usage["completion_tokens"].get<int>(),
-        agent_executor->usage["total_tokens"].get<int>(),
-        agent_executor->nlop, agent_executor->nlops
+        agent_executor->usage.value("completion_tokens", 0),
+        agent_executor->usage.value("total_tokens", 0),
+        agent_executor->nlop, agent_executor->nlops,
+        pool.connects, pool.reused, pool.hits, pool.misses,
+        pool.handshake_ms,
+        rate.throttled, rate.retries, rate.failures, rate.wait_ms,
+        rate.max_queue_depth, rate.concurrency,
+        hedge.hedged, hedge.requests, hedge.hedge_wins, hedge.threshold_ms,
+        cache.hits, cache.misses, cache.evictions, static_cast<double>(cache.bytes) / (1 << 20),
+        semantic.hits, semantic.lookups, semantic.saved_ms, semantic.false_hits, semantic.sampled,
+        cached_tokens, prompt_tokens, prompt_tokens ? 100.0 * cached_tokens / prompt_tokens : 0.0,
+        prefix.hit_calls ? prefix.hit_time / 1e3 / prefix.hit_calls : 0.0,
+        prefix.miss_calls ? prefix.miss_time / 1e3 / prefix.miss_calls : 0.0
     );
+    if (recorder) {
+        fmt::print("Trace: {} requests recorded to {}\n", recorder->get_recorded(), trace);
+    }
+    if (replay) {
+        auto replayed = replay->get_stats();
+        fmt::print("Trace: {} requests replayed from {} ({} not matched by hash)\n",
+            replayed.replayed, trace, replayed.fallbacks);
+    }
 
     exit(EXIT_SUCCESS);
 
@@ -3,53 +3,80 @@
 #include "core.h"
 #include "pgvector.h"
 #include "llm.h"
+#include "embedding_cache.h"
 
 class MemoryController {
 private:
+    /// Chunk whose embedding is in flight on the reactor as part of a
+    /// batch request, or already known from the embedding cache
+    struct pending_chunk {
+        std::string content_id;
+        int chunk_id;
+        std::string content;
+        std::optional<std::string> name;
+        std::optional<std::string> meta;
+        std::shared_future<liboai::Response> response;
+        size_t batch_index;
+        std::optional<vdb::vector> cached;
+    };
+
     LLM& __llm;
     PgVector& __vdb; /// TODO: MemoryInterface
 
-    std::vector<std::future<expected<mem_chunk*, std::string>>> futures;
+    std::vector<pending_chunk> pending_chunks;
     std::deque<mem_chunk> mem_chunks;
     std::mutex mem_chunks_mutex;
 
     embedding_model embed_model;
+    EmbeddingCache embedding_cache;
+
+    /// Budgets of one embedding request
+    size_t batch_max_tokens;
+    size_t batch_max_items;
 
     /// Stats
     double processed_kb;
     int processed_tokens;
 
 private:
-    expected<mem_chunk*, std::string> chunk_embedding(
-        const std::string& content_id,
-        const int chunk_id,
-        const std::string& content,
-        const std::optional<std::string>& name = std::nullopt,
-        const std::optional<std::string>& meta = std::nullopt
-    ) {
+    expected<mem_chunk*, std::string> chunk_embedding(pending_chunk& pending) {
         guard("MemoryController::chunk_embedding")
-        fmt::print("\033[0mmem_chunk #{}#{}: Embedding started.\n", content_id, chunk_id);
-        std::string cleaned_content = content;
-        if (!is_valid_utf8(content)) {
-            fmt::print("\033[31mError: Invalid UTF-8 byte in content for chunk #{}#{}.\n", content_id, chunk_id);
-            cleaned_content = remove_invalid_utf8(content);
+        vdb::vector embedding;
+        if (pending.cached) {
+            embedding = std::move(*pending.cached);
+        } else {
+            const liboai::Response& response = pending.response.get();
+            /// Usage covers the whole batch, count it once
+            if (pending.batch_index == 0) {
+                processed_tokens += response.raw_json["usage"]["total_tokens"].get<int>();
+            }
+            const json& data = response.raw_json["data"];
+            const json* item = &data.at(pending.batch_index);
+            /// Results come back in input order; fall back to a search if not
+            if (item->value("index", pending.batch_index) != pending.batch_index) {
+                item = nullptr;
+                for (const auto& candidate : data) {
+                    if (candidate.value("index", SIZE_MAX) == pending.batch_index) {
+                        item = &candidate;
+                        break;
+                    }
+                }
+                if (!item) {
+                    throw std::runtime_error("Embedding missing from batch response");
+                }
+            }
+            const json& jres = (*item)["embedding"];
+            embedding = vdb::vector({ jres.begin(), jres.end() }, embed_model);
+            embedding_cache.put(embed_model, pending.content, embedding);
         }
-        size_t size_in_bytes = cleaned_content.size();
-        double size_in_kb = static_cast<double>(size_in_bytes) / 1024.0;
-        processed_kb += size_in_kb;
-        std::future<liboai::Response> future_res = __llm.embedding_async(cleaned_content, embed_model);
-        liboai::Response response = future_res.get();
-        processed_tokens += response["usage"]["total_tokens"].get<int>();
-        json jres = response["data"][0]["embedding"];
-        vdb::vector embedding({ jres.begin(), jres.end() }, embed_model);
-        fmt::print("\033[0mmem_chunk #{}#{}: Embedding completed.\n", content_id, chunk_id);
-        ///std::lock_guard<std::mutex> lock(mem_chunks_mutex);
+        fmt::print("\033[0mmem_chunk #{}#{}: Embedding completed.\n", pending.content_id, pending.chunk_id);
         mem_chunks.emplace_back(mem_chunk{
-            content_id, chunk_id, cleaned_content, embedding, name, meta
+            pending.content_id, pending.chunk_id, std::move(pending.content), embedding,
+            pending.name, pending.meta
         });
         return &mem_chunks.back();
         unguard()
-        return {};
+        return unexpected(fmt::format("#{}#{}", pending.content_id, pending.chunk_id));
     }
 
 public:
@@ -57,6 +84,24 @@ public:
         embed_model = embedding_model::oai_3small;
         processed_kb = 0;
         processed_tokens = 0;
+        batch_max_tokens = 8000;
+        batch_max_items = 256;
+        embedding_cache.configure(".cache/embeddings", 4096);
+    }
+
+    /// Estimated tokens and inputs per embedding request
+    void set_batch_limits(size_t max_tokens, size_t max_items) {
+        batch_max_tokens = max_tokens;
+        batch_max_items = std::max<size_t>(max_items, 1);
+    }
+
+    /// On-disk embedding store directory (empty keeps it in memory) and LRU size
+    void set_embedding_cache(const std::string& directory, size_t memory_entries) {
+        embedding_cache.configure(directory, memory_entries);
+    }
+
+    EmbeddingCache::stats get_embedding_cache_stats() {
+        return embedding_cache.get_stats();
     }
 
     embedding_model get_model() const { return embed_model; }
@@ -75,25 +120,73 @@ public:
         const std::optional<std::string>& meta = std::nullopt
     ) {
         std::string content_id = gen_index();
+        /// Chunks are packed into batch requests up to the token and item
+        /// budgets; batch holds their positions in pending_chunks
+        std::vector<size_t> batch;
+        double batch_tokens = 0;
+        auto flush = [&] {
+            if (batch.empty()) {
+                return;
+            }
+            std::vector<std::string> texts;
+            texts.reserve(batch.size());
+            for (size_t index : batch) {
+                texts.push_back(pending_chunks[index].content);
+            }
+            /// Requests are queued on the reactor; concurrency is bounded
+            /// by LLM::set_max_concurrency, not by the number of batches
+            std::shared_future<liboai::Response> response = __llm.embedding_async(texts, embed_model).share();
+            for (size_t i = 0; i < batch.size(); ++i) {
+                pending_chunks[batch[i]].response = response;
+                pending_chunks[batch[i]].batch_index = i;
+            }
+            batch.clear();
+            batch_tokens = 0;
+        };
         for (size_t chunk_id = 0; chunk_id < chunks.size(); ++chunk_id) {
-            std::string chunk_content = chunks[chunk_id];
             fmt::print("\033[0mmem_chunk #{}#{}: Processing started.\n", content_id, chunk_id);
-            futures.push_back(std::async(std::launch::async, 
-                &MemoryController::chunk_embedding, this, 
-                content_id, chunk_id, chunk_content, name, meta
-            ));
+            std::string cleaned_content = chunks[chunk_id];
+            if (!is_valid_utf8(cleaned_content)) {
+                fmt::print("\033[31mError: Invalid UTF-8 byte in content for chunk #{}#{}.\n", content_id, chunk_id);
+                cleaned_content = remove_invalid_utf8(cleaned_content);
+            }
+            processed_kb += static_cast<double>(cleaned_content.size()) / 1024.0;
+            /// Unchanged content was embedded before, no request needed
+            if (auto cached = embedding_cache.get(embed_model, cleaned_content)) {
+                pending_chunks.push_back(pending_chunk{
+                    content_id, static_cast<int>(chunk_id), std::move(cleaned_content),
+                    name, meta, {}, 0, std::move(cached)
+                });
+                continue;
+            }
+            double tokens = static_cast<double>(Tokenizer::get_instance()->count(cleaned_content));
+            if (!batch.empty() && (batch.size() >= batch_max_items || batch_tokens + tokens > batch_max_tokens)) {
+                flush();
+            }
+            batch_tokens += tokens;
+            batch.push_back(pending_chunks.size());
+            pending_chunks.push_back(pending_chunk{
+                content_id, static_cast<int>(chunk_id), std::move(cleaned_content),
+                name, meta, {}, 0, std::nullopt
+            });
         }
+        flush();
     }
 
     expected<void, std::vector<int>> write_chunks(const std::string& collection) {
         std::vector<int> failed_chunks;
         guard("MemoryController::write_chunks")
         auto txn = __vdb.create_transaction();
-        for (auto& fut : futures) {
-            auto res = fut.get();
+        for (auto& pending : pending_chunks) {
+            expected<mem_chunk*, std::string> res = unexpected(std::string());
+            try {
+                res = chunk_embedding(pending);
+            } catch (const std::exception& e) {
+                res = unexpected(std::string(e.what()));
+            }
             if (!res.has_value()) {
                 fmt::print("\033[31mError processing chunk {}\n", res.error());
-                failed_chunks.push_back(fut.get().value()->chunk_id);
+                failed_chunks.push_back(pending.chunk_id);
                 continue;
             }
             mem_chunk* chunk = res.value();
@@ -102,10 +195,13 @@ public:
                 chunk->content_id, chunk->chunk_id);
         }
         __vdb.commit_transaction(txn);
+        auto cache_stats = embedding_cache.get_stats();
         fmt::print("\n{} chunks have been processed\n{} failed chunks\n"
-            "{} processed tokens\n{:.2f} MB of data processed\n",
-            mem_chunks.size(), failed_chunks.size(), processed_tokens, processed_kb / 1024.0);
-        futures.clear();
+            "{} processed tokens\n{:.2f} MB of data processed\n"
+            "{} embeddings from cache ({} memory, {} disk)\n",
+            mem_chunks.size(), failed_chunks.size(), processed_tokens, processed_kb / 1024.0,
+            cache_stats.memory_hits + cache_stats.disk_hits, cache_stats.memory_hits, cache_stats.disk_hits);
+        pending_chunks.clear();
         {
             ///std::lock_guard<std::mutex> lock(mem_chunks_mutex);
             mem_chunks.clear();
@@ -127,9 +223,16 @@ public:
     ) {
         guard("MemoryController::read_chunks")
         fmt::print("Fetch query: {}\n\n", query);
-        liboai::Response response = __llm.embedding(query, embed_model);
-        json jres = response["data"][0]["embedding"];
-        vdb::vector query_vector = vdb::vector({ jres.begin(), jres.end() }, embed_model);
+        auto cached = embedding_cache.get(embed_model, query);
+        vdb::vector query_vector;
+        if (cached) {
+            query_vector = std::move(*cached);
+        } else {
+            liboai::Response response = __llm.embedding(query, embed_model);
+            json jres = response["data"][0]["embedding"];
+            query_vector = vdb::vector({ jres.begin(), jres.end() }, embed_model);
+            embedding_cache.put(embed_model, query, query_vector);
+        }
         auto result = __vdb.search_content(collection, query_vector, count, 
             vdb::query_type::cosine_similarity);
         return result;
@@ -0,0 +1,293 @@
+#pragma once
+
+#include "llm_backend.h"
+
+///
+/// @brief In-process backend for benchmarks without a network
+///
+/// Chat completions replay a script of assistant messages in order (the
+/// n-th request gets entry n modulo the script length) after a latency
+/// drawn from a configured distribution. Request n always draws the same
+/// latency for a given seed. Embeddings are hashed bags of words, so texts
+/// sharing words are close and the same text always embeds the same.
+///
+class MockBackend : public LLMBackend {
+public:
+    struct latency {
+        enum class distribution { fixed, uniform, normal, lognormal };
+        distribution shape{distribution::fixed};
+        double mean_ms{0};
+        double spread_ms{0};    /// Half width for uniform, standard deviation otherwise
+
+        static latency parse(const std::string& shape, double mean_ms, double spread_ms) {
+            static const std::map<std::string, distribution> shapes{
+                {"fixed", distribution::fixed},
+                {"uniform", distribution::uniform},
+                {"normal", distribution::normal},
+                {"lognormal", distribution::lognormal}
+            };
+            auto found = shapes.find(shape);
+            if (found == shapes.end()) {
+                throw std::runtime_error("Unknown latency distribution '" + shape + "'");
+            }
+            return latency{found->second, std::max(mean_ms, 0.0), std::max(spread_ms, 0.0)};
+        }
+    };
+
+private:
+    std::mutex mutex;
+    std::vector<std::string> script{"Done.\n\n<<RETURN>>"};
+    latency chat_latency;
+    latency embedding_latency;
+    uint64_t seed{0};
+    std::atomic<uint64_t> chat_requests{0};
+    std::atomic<uint64_t> embedding_requests{0};
+
+    static uint64_t mix(uint64_t x) {
+        /// splitmix64 finalizer
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    static uint64_t hash(std::string_view text) {
+        fnv_hasher h;
+        h.update(text);
+        return h.a;
+    }
+
+    std::chrono::microseconds sample(const latency& model, uint64_t request) {
+        std::mt19937_64 rng(mix(seed ^ mix(request)));
+        double ms = model.mean_ms;
+        switch (model.shape) {
+        case latency::distribution::fixed:
+            break;
+        case latency::distribution::uniform:
+            ms = std::uniform_real_distribution<double>(model.mean_ms - model.spread_ms, model.mean_ms + model.spread_ms)(rng);
+            break;
+        case latency::distribution::normal:
+            if (model.spread_ms > 0) {
+                ms = std::normal_distribution<double>(model.mean_ms, model.spread_ms)(rng);
+            }
+            break;
+        case latency::distribution::lognormal:
+            if (model.mean_ms > 0 && model.spread_ms > 0) {
+                /// Parameters that give the configured mean and deviation
+                double variance = std::log(1.0 + (model.spread_ms * model.spread_ms) / (model.mean_ms * model.mean_ms));
+                double mu = std::log(model.mean_ms) - variance / 2;
+                ms = std::lognormal_distribution<double>(mu, std::sqrt(variance))(rng);
+            }
+            break;
+        }
+        return std::chrono::microseconds(static_cast<long long>(std::max(ms, 0.0) * 1000));
+    }
+
+    static long estimate_tokens(size_t bytes) {
+        return static_cast<long>((bytes + 3) / 4);
+    }
+
+    struct scripted {
+        uint64_t request;
+        std::string content;
+        long prompt_tokens;
+        std::chrono::microseconds latency;
+    };
+
+    /// Everything a request needs, taken before it runs so the conversation may change
+    scripted next_completion(const liboai::Conversation& conversation, const std::vector<std::string>& stop) {
+        uint64_t request = chat_requests++;
+        size_t bytes = 0;
+        for (const auto& message : conversation.GetSerializedMessages()) {
+            bytes += message->size();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string content = script[request % script.size()];
+        for (const auto& sequence : stop) {
+            size_t found = content.find(sequence);
+            if (!sequence.empty() && found != std::string::npos) {
+                content.resize(found);
+            }
+        }
+        return scripted{request, std::move(content), estimate_tokens(bytes), sample(chat_latency, request)};
+    }
+
+    static json usage(const scripted& completion) {
+        long completion_tokens = estimate_tokens(completion.content.size());
+        return {
+            {"prompt_tokens", completion.prompt_tokens},
+            {"completion_tokens", completion_tokens},
+            {"total_tokens", completion.prompt_tokens + completion_tokens}
+        };
+    }
+
+    static liboai::Response completion_response(const std::string& model, const scripted& completion) {
+        json body = {
+            {"id", fmt::format("mock-{}", completion.request)},
+            {"object", "chat.completion"},
+            {"model", model},
+            {"choices", json::array({
+                {
+                    {"index", 0},
+                    {"message", {{"role", "assistant"}, {"content", completion.content}}},
+                    {"finish_reason", "stop"}
+                }
+            })},
+            {"usage", usage(completion)}
+        };
+        return liboai::Response("mock://chat/completions", body.dump(), "HTTP/1.1 200 OK", "OK", 200,
+            static_cast<double>(completion.latency.count()) / 1e3, -1);
+    }
+
+    std::vector<float> embed(embedding_model model, std::string_view text) {
+        size_t dimensions = static_cast<size_t>(model);
+        std::vector<float> result(dimensions, 0.0f);
+        std::string word;
+        auto add_word = [&] {
+            if (word.empty()) {
+                return;
+            }
+            uint64_t base = mix(hash(word) ^ seed);
+            for (size_t i = 0; i < dimensions; ++i) {
+                result[i] += static_cast<float>(static_cast<int64_t>(mix(base + i))) / 9.2233720368547758e18f;
+            }
+            word.clear();
+        };
+        for (char c : text) {
+            if (std::isalnum(static_cast<unsigned char>(c))) {
+                word += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            } else {
+                add_word();
+            }
+        }
+        add_word();
+        double norm = 0;
+        for (float x : result) norm += static_cast<double>(x) * x;
+        if (norm > 0) {
+            float scale = static_cast<float>(1.0 / std::sqrt(norm));
+            for (float& x : result) x *= scale;
+        }
+        return result;
+    }
+
+    liboai::Response embedding_response(embedding_model model, const std::vector<std::string>& texts, uint64_t request) {
+        json data = json::array();
+        size_t bytes = 0;
+        for (size_t i = 0; i < texts.size(); ++i) {
+            data.push_back({{"object", "embedding"}, {"index", i}, {"embedding", embed(model, texts[i])}});
+            bytes += texts[i].size();
+        }
+        std::chrono::microseconds delay;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            delay = sample(embedding_latency, request);
+        }
+        wait(delay, CancelToken{});
+        json body = {
+            {"object", "list"},
+            {"model", fmt::format("{}", model)},
+            {"data", std::move(data)},
+            {"usage", {{"prompt_tokens", estimate_tokens(bytes)}, {"total_tokens", estimate_tokens(bytes)}}}
+        };
+        return liboai::Response("mock://embeddings", body.dump(), "HTTP/1.1 200 OK", "OK", 200,
+            static_cast<double>(delay.count()) / 1e3, -1);
+    }
+
+public:
+    /// Assistant messages returned in order, repeating from the start
+    void set_script(std::vector<std::string> messages) {
+        if (messages.empty()) {
+            throw std::runtime_error("Mock script is empty");
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        script = std::move(messages);
+    }
+
+    /// Script from a JSON array of strings
+    void load_script(const std::string& filename) {
+        json messages = json::parse(read_file(filename));
+        set_script(messages.get<std::vector<std::string>>());
+    }
+
+    void set_latency(latency chat, latency embeddings) {
+        std::lock_guard<std::mutex> lock(mutex);
+        chat_latency = chat;
+        embedding_latency = embeddings;
+    }
+
+    void set_seed(uint64_t new_seed) {
+        std::lock_guard<std::mutex> lock(mutex);
+        seed = new_seed;
+    }
+
+    /// Completions follow the script, so a different script is another source
+    std::string endpoint() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t hash = 0;
+        for (const auto& message : script) {
+            hash = hash * 31 + std::hash<std::string>{}(message);
+        }
+        return fmt::format("mock:{:016x}", hash);
+    }
+
+    liboai::Response chat_completion(const std::string& model, const liboai::Conversation& conversation,
+        float, const std::vector<std::string>& stop, std::optional<StreamCallback> stream = std::nullopt) override {
+        scripted completion = next_completion(conversation, stop);
+        if (!stream) {
+            wait(completion.latency, CancelToken{});
+            return completion_response(model, completion);
+        }
+        /// Server-sent events of a few characters each, the latency spread over them
+        constexpr size_t chunk = 16;
+        size_t chunks = std::max<size_t>((completion.content.size() + chunk - 1) / chunk, 1);
+        auto step = completion.latency / chunks;
+        for (size_t offset = 0; offset < completion.content.size(); offset += chunk) {
+            wait(step, CancelToken{});
+            json event = {{"choices", json::array({
+                {{"index", 0}, {"delta", {{"content", completion.content.substr(offset, chunk)}}}}
+            })}};
+            if (!(*stream)("data: " + event.dump() + "\n\n", 0)) {
+                return liboai::Response("mock://chat/completions", "", "HTTP/1.1 200 OK", "OK", 200, 0.0, -1);
+            }
+        }
+        /// Usage-only chunk, as sent for stream_options.include_usage
+        json usage_event = {{"choices", json::array()}, {"usage", usage(completion)}};
+        (*stream)("data: " + usage_event.dump() + "\n\n", 0);
+        (*stream)("data: [DONE]\n\n", 0);
+        return liboai::Response("mock://chat/completions", "", "HTTP/1.1 200 OK", "OK", 200,
+            static_cast<double>(completion.latency.count()) / 1e3, -1);
+    }
+
+    std::future<liboai::Response> chat_completion_async(const std::string& model, const liboai::Conversation& conversation,
+        float, const std::vector<std::string>& stop, CancelToken cancel, CompletionHook hook = {}) override {
+        scripted completion = next_completion(conversation, stop);
+        return std::async(std::launch::async, [model, completion = std::move(completion), cancel = std::move(cancel), hook = std::move(hook)] {
+            return completing(hook, [&] {
+                wait(completion.latency, cancel);
+                return completion_response(model, completion);
+            });
+        });
+    }
+
+    liboai::Response embedding(embedding_model model, const std::string& text) override {
+        return embedding_response(model, {text}, embedding_requests++);
+    }
+
+    liboai::Response embedding(embedding_model model, const std::vector<std::string>& texts) override {
+        return embedding_response(model, texts, embedding_requests++);
+    }
+
+    std::future<liboai::Response> embedding_async(embedding_model model, const std::string& text, CompletionHook hook = {}) override {
+        uint64_t request = embedding_requests++;
+        return std::async(std::launch::async, [this, model, text, request, hook = std::move(hook)] {
+            return completing(hook, [&] { return embedding_response(model, {text}, request); });
+        });
+    }
+
+    std::future<liboai::Response> embedding_async(embedding_model model, const std::vector<std::string>& texts, CompletionHook hook = {}) override {
+        uint64_t request = embedding_requests++;
+        return std::async(std::launch::async, [this, model, texts, request, hook = std::move(hook)] {
+            return completing(hook, [&] { return embedding_response(model, texts, request); });
+        });
+    }
+};
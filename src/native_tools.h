@@ -27,13 +27,18 @@ std::string tool_memory(std::shared_ptr<AgentExecutor> ce_ref, json args) {
 std::string tool_send_message(std::shared_ptr<AgentExecutor> ce_ref, json args) {
     std::string answer;
     if (args.contains("message")) {
+        std::string message = args["message"];
+        /// Sessions without a console keep their messages in their log
+        if (!ce_ref->is_interactive()) {
+            ce_ref->get_logger()->log("[message] " + message);
+            return fmt::format("The message: '{}' was successfully displayed", message);
+        }
         if (!debug) {
             std::string completion = ce_ref->agent_executor_state["output"];
             completion = string_in_line(completion);
             completion += "\n";
             stop_spinner(completion);
         }
-        std::string message = args["message"];
         std::cout << GREEN << "[message] " << RESET << message << "\n";
         std::string answer = fmt::format(
             "The message: '{}' was successfully displayed",
@@ -46,6 +51,9 @@ std::string tool_send_message(std::shared_ptr<AgentExecutor> ce_ref, json args)
 std::string tool_user_input(std::shared_ptr<AgentExecutor> ce_ref, json args) {
     std::string answer;
     if (args.contains("prompt")) {
+        if (!ce_ref->is_interactive()) {
+            return "User input is not available in this session, continue without it.";
+        }
         if (!debug) {
             std::string completion = ce_ref->agent_executor_state["output"].get<std::string>();
             completion = string_in_line(completion);
@@ -64,11 +72,10 @@ std::string tool_user_input(std::shared_ptr<AgentExecutor> ce_ref, json args) {
 }
 
 std::string tool_read_file(std::shared_ptr<AgentExecutor> ce_ref, json args) {
-    (void)ce_ref;
     std::string answer;
     if (args.contains("file_path")) {
         std::string file_path = args["file_path"];
-        std::string file_content = read_file(file_path);
+        std::string file_content = read_file(ce_ref->workspace_path(file_path));
         if (debug) {
             print_in_line(CYAN, "[read_file_path]\t", file_path); 
             print_in_line(CYAN, "[read_file_content]\t", file_content);
@@ -84,7 +91,6 @@ std::string tool_read_file(std::shared_ptr<AgentExecutor> ce_ref, json args) {
 }
 
 std::string tool_write_file(std::shared_ptr<AgentExecutor> ce_ref, json args) {
-    (void)ce_ref;
     std::string answer;
     if (args.contains("file_path")) {
         std::string file_path = args["file_path"];
@@ -93,7 +99,7 @@ std::string tool_write_file(std::shared_ptr<AgentExecutor> ce_ref, json args) {
             print_in_line(CYAN, "[write_file_path]\t", file_path); 
             print_in_line(CYAN, "[write_file_content]\t", file_content);
         }
-        write_file(file_path, file_content);
+        write_file(ce_ref->workspace_path(file_path), file_content);
         answer = fmt::format(
             "The content: '{}' "
             "was written to the file: '{}'", 
@@ -105,7 +111,6 @@ std::string tool_write_file(std::shared_ptr<AgentExecutor> ce_ref, json args) {
 }
 
 std::string tool_append_file(std::shared_ptr<AgentExecutor> ce_ref, json args) {
-    (void)ce_ref;
     std::string answer;
     if (args.contains("file_path")) {
         std::string file_path = args["file_path"];
@@ -114,7 +119,7 @@ std::string tool_append_file(std::shared_ptr<AgentExecutor> ce_ref, json args) {
             print_in_line(CYAN, "[append_file_path]\t", file_path); 
             print_in_line(CYAN, "[append_file_content]\t", file_content);
         }
-        append_file(file_path, file_content);
+        append_file(ce_ref->workspace_path(file_path), file_content);
         answer = fmt::format(
             "The content: '{}' "
             "was appended to the file: '{}'", 
@@ -126,11 +131,13 @@ std::string tool_append_file(std::shared_ptr<AgentExecutor> ce_ref, json args) {
 }
 
 std::string tool_execute_bash_command(std::shared_ptr<AgentExecutor> ce_ref, json args) {
-    (void)ce_ref;
     std::string answer;
     if (args.contains("command")) {
         std::string command = std::string(args["command"]);
-        std::string stdout = execute_command(command);
+        /// Run from the session workspace
+        std::string stdout = ce_ref->get_workspace().empty()
+            ? execute_command(command)
+            : execute_command("cd \"" + ce_ref->get_workspace() + "\" && " + command);
         if (stdout.empty()) {
             stdout = "Success";
         }
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "core.h"
+
+///
+/// @brief Prompt template parsed once and rendered from its slots
+///
+/// The text is split at its {{variables}}. Each variable is a slot holding
+/// its value as given and as rendered (JSON escaped, like render_template),
+/// so setting a slot to the value it already has costs a comparison and
+/// rendering only joins the pieces. A variable that was never set renders
+/// as it was written.
+///
+class PromptTemplate {
+    struct slot {
+        std::string name;
+        std::string value;
+        std::string rendered;
+        bool set{false};
+    };
+
+    std::vector<std::string> literals;  /// Text before each variable, and after the last
+    std::vector<size_t> occurrences;    /// Slot of each variable in the text
+    std::vector<slot> slots;
+
+public:
+    PromptTemplate() : literals{""} {}
+
+    explicit PromptTemplate(const std::string& text) {
+        size_t pos = 0;
+        for (;;) {
+            size_t open = text.find("{{", pos);
+            size_t close = open == std::string::npos ? open : text.find("}}", open + 2);
+            if (close == std::string::npos) {
+                literals.push_back(text.substr(pos));
+                break;
+            }
+            std::string name = text.substr(open + 2, close - open - 2);
+            literals.push_back(text.substr(pos, open - pos));
+            auto found = std::find_if(slots.begin(), slots.end(), [&](const slot& s) { return s.name == name; });
+            occurrences.push_back(static_cast<size_t>(found - slots.begin()));
+            if (found == slots.end()) {
+                slots.push_back({name, "", "{{" + name + "}}"});
+            }
+            pos = close + 2;
+        }
+    }
+
+    /// @return false when the template has no such variable
+    bool set(const std::string& name, const std::string& value) {
+        for (auto& s : slots) {
+            if (s.name != name) {
+                continue;
+            }
+            if (!s.set || s.value != value) {
+                s.value = value;
+                s.rendered = escape_json(value);
+                s.set = true;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    std::string render() const {
+        size_t size = 0;
+        for (const auto& literal : literals) {
+            size += literal.size();
+        }
+        for (size_t index : occurrences) {
+            size += slots[index].rendered.size();
+        }
+        std::string result;
+        result.reserve(size);
+        for (size_t i = 0; i < occurrences.size(); ++i) {
+            result += literals[i];
+            result += slots[occurrences[i]].rendered;
+        }
+        result += literals.back();
+        return result;
+    }
+};
@@ -0,0 +1,302 @@
+#pragma once
+
+#include "core.h"
+#include "liboai.h"
+
+#include <condition_variable>
+#include <cmath>
+
+///
+/// @brief Shared budget for all LLM traffic
+///
+/// Requests-per-minute and tokens-per-minute budgets are token buckets,
+/// concurrency follows AIMD (additive increase on success, halving on 429)
+/// and rate-limited calls are retried after Retry-After or a jittered
+/// exponential backoff. The async path is bounded by the reactor, whose
+/// limit follows the same AIMD window.
+///
+class RateGovernor {
+public:
+    struct stats {
+        uint64_t requests{0};
+        uint64_t throttled{0};      /// 429 responses
+        uint64_t retries{0};
+        uint64_t failures{0};       /// Gave up after max retries
+        size_t queue_depth{0};      /// Callers waiting for budget right now
+        size_t max_queue_depth{0};
+        double wait_ms{0};          /// Total time spent waiting for budget
+        double concurrency{0};      /// Current AIMD window
+    };
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    /// Per-minute budget refilled continuously, 0 capacity is unlimited
+    struct bucket {
+        double capacity{0};
+        double level{0};
+        clock::time_point refilled{clock::now()};
+
+        void reset(double per_minute) {
+            capacity = per_minute;
+            level = per_minute;
+            refilled = clock::now();
+        }
+
+        void refill(clock::time_point now) {
+            double elapsed_ms = std::chrono::duration<double, std::milli>(now - refilled).count();
+            level = std::min(capacity, level + elapsed_ms * capacity / 60000.0);
+            refilled = now;
+        }
+
+        /// Time until amount is available; oversized requests only need a full bucket
+        clock::duration wait_for(double amount) const {
+            if (capacity <= 0) return clock::duration::zero();
+            double missing = std::min(amount, capacity) - level;
+            if (missing <= 0) return clock::duration::zero();
+            return std::chrono::duration_cast<clock::duration>(
+                std::chrono::duration<double, std::milli>(missing * 60000.0 / capacity)
+            );
+        }
+
+        void take(double amount) {
+            if (capacity > 0) level -= amount;
+        }
+
+        void give_back(double amount) {
+            if (capacity > 0) level = std::min(capacity, level + amount);
+        }
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bucket requests_bucket;
+    bucket tokens_bucket;
+
+    double window{16};              /// AIMD concurrency window
+    size_t max_window{16};          /// 0 disables the window
+    size_t in_flight{0};
+    clock::time_point paused_until{};
+    clock::time_point last_decrease{};
+
+    int max_retries{5};
+    double base_backoff_ms{500};
+    double max_backoff_ms{30000};
+
+    stats counters;
+    std::mt19937 rng{std::random_device{}()};
+
+    RateGovernor() = default;
+
+    /// Called with mutex held
+    void apply_window() {
+        if (max_window) {
+            liboai::netimpl::Reactor::Instance().SetMaxConcurrency(static_cast<size_t>(window));
+        }
+    }
+
+    double random_ms(double max_ms) {
+        std::uniform_real_distribution<double> dist(0.0, std::max(0.0, max_ms));
+        return dist(rng);
+    }
+
+public:
+    RateGovernor(const RateGovernor&) = delete;
+    RateGovernor& operator=(const RateGovernor&) = delete;
+
+    static RateGovernor* get_instance() {
+        static RateGovernor instance;
+        return &instance;
+    }
+
+    /// Budgets per minute, 0 is unlimited
+    void set_limits(double rpm, double tpm, int retries) {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests_bucket.reset(rpm);
+        tokens_bucket.reset(tpm);
+        max_retries = retries;
+    }
+
+    /// Ceiling of the AIMD window, also applied to the reactor; 0 is unbounded
+    void set_max_concurrency(size_t max_concurrency) {
+        std::lock_guard<std::mutex> lock(mutex);
+        max_window = max_concurrency;
+        window = static_cast<double>(max_concurrency);
+        liboai::netimpl::Reactor::Instance().SetMaxConcurrency(max_concurrency);
+    }
+
+    ///
+    /// Blocks until the request fits the budgets. Windowed callers also
+    /// take a concurrency slot and must call release() when done; the
+    /// async path leaves concurrency to the reactor.
+    ///
+    void acquire(double tokens, bool windowed) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto start = clock::now();
+        counters.queue_depth++;
+        counters.max_queue_depth = std::max(counters.max_queue_depth, counters.queue_depth);
+        for (;;) {
+            auto now = clock::now();
+            requests_bucket.refill(now);
+            tokens_bucket.refill(now);
+
+            clock::duration wait = std::max({
+                paused_until > now ? paused_until - now : clock::duration::zero(),
+                requests_bucket.wait_for(1),
+                tokens_bucket.wait_for(tokens)
+            });
+            bool slot = !windowed || !max_window || in_flight < static_cast<size_t>(window);
+            if (wait == clock::duration::zero() && slot) {
+                break;
+            }
+            if (wait > clock::duration::zero()) {
+                cv.wait_for(lock, wait);
+            } else {
+                cv.wait(lock);
+            }
+        }
+        requests_bucket.take(1);
+        tokens_bucket.take(tokens);
+        if (windowed) {
+            in_flight++;
+        }
+        counters.queue_depth--;
+        counters.requests++;
+        counters.wait_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+
+    /// Non-blocking variant for optional traffic such as hedges
+    bool try_acquire(double tokens) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = clock::now();
+        requests_bucket.refill(now);
+        tokens_bucket.refill(now);
+        if (paused_until > now ||
+            requests_bucket.wait_for(1) > clock::duration::zero() ||
+            tokens_bucket.wait_for(tokens) > clock::duration::zero()) {
+            return false;
+        }
+        requests_bucket.take(1);
+        tokens_bucket.take(tokens);
+        counters.requests++;
+        return true;
+    }
+
+    /// Returns what try_acquire took for a request that was not sent after all
+    void refund(double tokens) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests_bucket.give_back(1);
+            tokens_bucket.give_back(tokens);
+            counters.requests--;
+        }
+        cv.notify_all();
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_flight--;
+        }
+        cv.notify_all();
+    }
+
+    /// Settles the token estimate against actual usage and grows the window
+    void on_success(double estimated_tokens, double actual_tokens) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tokens_bucket.take(actual_tokens - estimated_tokens);
+        if (max_window && window < max_window) {
+            size_t before = static_cast<size_t>(window);
+            window = std::min<double>(max_window, window + 1.0 / window);
+            if (static_cast<size_t>(window) != before) {
+                apply_window();
+            }
+        }
+    }
+
+    /// Halves the window (once per burst) and pauses everyone for Retry-After
+    void on_throttled(long retry_after_ms) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto now = clock::now();
+            counters.throttled++;
+            if (max_window && now - last_decrease > std::chrono::seconds(1)) {
+                window = std::max(1.0, window / 2.0);
+                last_decrease = now;
+                apply_window();
+            }
+            if (retry_after_ms >= 0) {
+                paused_until = std::max(paused_until, now + std::chrono::milliseconds(retry_after_ms));
+            }
+        }
+        cv.notify_all();
+    }
+
+    ///
+    /// Delay before the next attempt. With Retry-After the shared pause
+    /// already covers the wait and only a small jitter spreads the callers;
+    /// without it full jitter over an exponentially growing cap.
+    ///
+    std::chrono::milliseconds backoff(int attempt, long retry_after_ms) {
+        std::lock_guard<std::mutex> lock(mutex);
+        double ms = retry_after_ms >= 0
+            ? random_ms(std::min(base_backoff_ms, 1000.0))
+            : random_ms(std::min(max_backoff_ms, base_backoff_ms * std::pow(2.0, attempt)));
+        return std::chrono::milliseconds(static_cast<long>(ms));
+    }
+
+    /// Returns true if another attempt is allowed
+    bool should_retry(int attempt) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (attempt >= max_retries) {
+            counters.failures++;
+            return false;
+        }
+        counters.retries++;
+        return true;
+    }
+
+    static double usage_tokens(const liboai::Response& response, double fallback) {
+        const json& usage = response.GetUsage();
+        return usage.is_object() ? usage.value("total_tokens", fallback) : fallback;
+    }
+
+    /// Rough prompt size before the tokenizer sees it
+    static double estimate_tokens(size_t bytes) {
+        return static_cast<double>(bytes) / 4.0 + 1.0;
+    }
+
+    ///
+    /// Runs a blocking request within the budgets, retrying on 429.
+    /// attempt > 0 continues a retry sequence started elsewhere.
+    ///
+    template <typename Call>
+    liboai::Response run(double tokens, Call&& call, int attempt = 0) {
+        for (;; ++attempt) {
+            acquire(tokens, true);
+            try {
+                liboai::Response response = call();
+                release();
+                on_success(tokens, usage_tokens(response, tokens));
+                return response;
+            } catch (const liboai::exception::OpenAIRateLimited& e) {
+                release();
+                on_throttled(e.GetRetryAfterMs());
+                if (!should_retry(attempt)) {
+                    throw;
+                }
+                std::this_thread::sleep_for(backoff(attempt, e.GetRetryAfterMs()));
+            } catch (...) {
+                release();
+                throw;
+            }
+        }
+    }
+
+    stats get_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats result = counters;
+        result.concurrency = window;
+        return result;
+    }
+};
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "core.h"
+
+///
+/// @brief Similarity cache of chat completions
+///
+/// Completions of cacheable instructions are stored with the embedding of
+/// the conversation's final turn. A later request in the same scope whose
+/// final turn embeds within the similarity threshold gets the stored
+/// completion back. Candidates come from random-hyperplane LSH tables and
+/// are confirmed by exact cosine similarity. A sample of hits is also sent
+/// to the LLM to measure how often the cached answer differs.
+///
+class SemanticCache {
+public:
+    struct stats {
+        uint64_t lookups{0};
+        uint64_t hits{0};           /// Served from the cache
+        double saved_ms{0};         /// Original latency of the completions served from cache
+        uint64_t sampled{0};        /// Hits checked against a fresh completion
+        uint64_t false_hits{0};     /// Checked hits whose fresh answer was not similar
+    };
+
+    struct match {
+        json completion;
+        double similarity;
+        size_t id;
+        double latency_ms;          /// Of the stored completion
+    };
+
+private:
+    static constexpr size_t tables = 4;
+    static constexpr size_t bits = 12;
+    static constexpr size_t max_entries = 4096;
+
+    struct entry {
+        size_t id;
+        std::string scope;
+        std::vector<float> embedding;       /// Unit length
+        json completion;
+        double latency_ms;
+        std::array<uint32_t, tables> buckets;
+    };
+
+    std::mutex mutex;
+    double threshold{0};                    /// 0 disables the cache
+    double sample_rate{0};
+    std::deque<entry> entries;
+    size_t next_id{0};
+    std::array<std::unordered_map<uint32_t, std::vector<size_t>>, tables> index;
+    std::vector<float> planes;              /// tables * bits hyperplanes, created on first use
+    size_t dimensions{0};
+    std::mt19937 rng{std::random_device{}()};
+    stats counters;
+
+    static void normalize(std::vector<float>& v) {
+        double norm = 0;
+        for (float x : v) norm += static_cast<double>(x) * x;
+        norm = std::sqrt(norm);
+        if (norm > 0) {
+            for (float& x : v) x = static_cast<float>(x / norm);
+        }
+    }
+
+    static double dot(const std::vector<float>& a, const std::vector<float>& b) {
+        double sum = 0;
+        for (size_t i = 0; i < a.size(); ++i) sum += static_cast<double>(a[i]) * b[i];
+        return sum;
+    }
+
+    /// Called with mutex held
+    std::array<uint32_t, tables> hash(const std::vector<float>& v) {
+        if (planes.empty()) {
+            dimensions = v.size();
+            std::normal_distribution<float> dist(0.0f, 1.0f);
+            planes.resize(tables * bits * dimensions);
+            for (float& x : planes) x = dist(rng);
+        }
+        std::array<uint32_t, tables> result{};
+        for (size_t t = 0; t < tables; ++t) {
+            for (size_t b = 0; b < bits; ++b) {
+                const float* plane = &planes[(t * bits + b) * dimensions];
+                double side = 0;
+                for (size_t i = 0; i < dimensions; ++i) side += static_cast<double>(plane[i]) * v[i];
+                result[t] |= static_cast<uint32_t>(side >= 0) << b;
+            }
+        }
+        return result;
+    }
+
+    /// Called with mutex held
+    void evict_oldest() {
+        const entry& oldest = entries.front();
+        for (size_t t = 0; t < tables; ++t) {
+            auto& bucket = index[t][oldest.buckets[t]];
+            bucket.erase(std::remove(bucket.begin(), bucket.end(), oldest.id), bucket.end());
+        }
+        entries.pop_front();
+    }
+
+    /// Called with mutex held; ids grow with the deque, so the position is the id offset
+    entry* find_entry(size_t id) {
+        if (entries.empty() || id < entries.front().id) {
+            return nullptr;
+        }
+        size_t position = id - entries.front().id;
+        return position < entries.size() ? &entries[position] : nullptr;
+    }
+
+public:
+    /// Cosine similarity needed for a hit (0 disables) and share of hits re-checked
+    void configure(double new_threshold, double new_sample_rate) {
+        std::lock_guard<std::mutex> lock(mutex);
+        threshold = std::clamp(new_threshold, 0.0, 1.0);
+        sample_rate = std::clamp(new_sample_rate, 0.0, 1.0);
+    }
+
+    bool enabled() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return threshold > 0;
+    }
+
+    std::optional<match> lookup(const std::string& scope, std::vector<float> embedding) {
+        normalize(embedding);
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.lookups++;
+        if (entries.empty() || embedding.size() != dimensions) {
+            return std::nullopt;
+        }
+        auto buckets = hash(embedding);
+        const entry* best = nullptr;
+        double best_similarity = threshold;
+        for (size_t t = 0; t < tables; ++t) {
+            auto it = index[t].find(buckets[t]);
+            if (it == index[t].end()) {
+                continue;
+            }
+            for (size_t id : it->second) {
+                const entry* candidate = find_entry(id);
+                if (!candidate || candidate->scope != scope) {
+                    continue;
+                }
+                double similarity = dot(candidate->embedding, embedding);
+                if (similarity >= best_similarity) {
+                    best = candidate;
+                    best_similarity = similarity;
+                }
+            }
+        }
+        if (!best) {
+            return std::nullopt;
+        }
+        return match{best->completion, best_similarity, best->id, best->latency_ms};
+    }
+
+    /// A hit served from the cache; sampled hits are not, they go to the LLM
+    void record_hit(const match& hit) {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.hits++;
+        counters.saved_ms += hit.latency_ms;
+    }
+
+    void insert(const std::string& scope, std::vector<float> embedding, json completion, double latency_ms) {
+        normalize(embedding);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!planes.empty() && embedding.size() != dimensions) {
+            return;
+        }
+        if (entries.size() >= max_entries) {
+            evict_oldest();
+        }
+        entry item{next_id++, scope, std::move(embedding), std::move(completion), latency_ms, {}};
+        item.buckets = hash(item.embedding);
+        for (size_t t = 0; t < tables; ++t) {
+            index[t][item.buckets[t]].push_back(item.id);
+        }
+        entries.push_back(std::move(item));
+    }
+
+    /// Whether two embeddings are within the hit threshold
+    bool similar(std::vector<float> a, std::vector<float> b) {
+        if (a.empty() || a.size() != b.size()) {
+            return false;
+        }
+        normalize(a);
+        normalize(b);
+        std::lock_guard<std::mutex> lock(mutex);
+        return dot(a, b) >= threshold;
+    }
+
+    /// Decides whether this hit is re-checked against the LLM
+    bool should_sample() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (sample_rate <= 0) {
+            return false;
+        }
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        return dist(rng) < sample_rate;
+    }
+
+    /// Outcome of a sampled hit; a differing answer replaces the stored one
+    void record_sample(size_t id, bool same, json fresh) {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.sampled++;
+        if (!same) {
+            counters.false_hits++;
+            if (entry* item = find_entry(id)) {
+                item->completion = std::move(fresh);
+            }
+        }
+    }
+
+    stats get_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+};
@@ -0,0 +1,561 @@
+#pragma once
+
+#include "core.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+///
+/// @brief Byte pair encoding tokenizer for cl100k_base and o200k_base
+///
+/// Ranks are read from a local .tiktoken file (base64 token and rank per
+/// line). Text is split with a hand-written version of the encoding's
+/// pre-tokenization pattern, then each piece is merged by rank. ASCII
+/// text, detected 16 bytes at a time with SSE2, is split without UTF-8
+/// decoding and matches tiktoken exactly. Outside ASCII, case and digits
+/// follow the Unicode tables for Latin, Greek, Cyrillic, Armenian and
+/// Georgian letters and every Nd digit; the rest is approximated by block
+/// (common spaces, punctuation, symbols, numbers, emoji and combining
+/// marks; everything else is a caseless letter). Cased scripts beyond those
+/// tables (Cherokee, Coptic, Glagolitic, ...) and symbols outside the listed
+/// blocks split differently from tiktoken.
+///
+/// Without a vocabulary, counts fall back to the bytes / 4 estimate.
+///
+class Tokenizer {
+public:
+    enum class encoding { cl100k_base, o200k_base };
+
+private:
+    struct string_hash {
+        using is_transparent = void;
+        size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+    };
+
+    std::unordered_map<std::string, uint32_t, string_hash, std::equal_to<>> ranks;
+    encoding pattern{encoding::cl100k_base};
+    std::atomic<bool> ready{false};
+
+    static constexpr uint32_t no_rank = std::numeric_limits<uint32_t>::max();
+
+    Tokenizer() = default;
+
+    /// Character classes, ASCII exact
+    enum class char_class : uint8_t { other, upper, lower, letter, mark, digit, space, newline, apostrophe };
+
+    /// General categories of a letter run: Lu (with Lt), Ll, Lo (with Lm),
+    /// Mn (any mark), Po (anything that is not a letter, number or space)
+    /// and LuLl, upper and lower case pairs alternating from the first
+    enum run_category : uint8_t { Lu, Ll, Lo, Mn, Po, LuLl };
+
+    struct letter_run {
+        uint32_t first;
+        uint32_t last;
+        run_category category;
+    };
+
+    /// Latin-1, Latin Extended, IPA, Greek, Cyrillic, Armenian, Georgian and
+    /// fullwidth Latin letters, sorted; unassigned codepoints join a neighbouring run
+    static constexpr letter_run letter_runs[] = {
+        {0x0080, 0x00A9, Po}, {0x00AA, 0x00AA, Lo}, {0x00AB, 0x00B4, Po}, {0x00B5, 0x00B5, Ll}, {0x00B6, 0x00B9, Po},
+        {0x00BA, 0x00BA, Lo}, {0x00BB, 0x00BF, Po}, {0x00C0, 0x00D6, Lu}, {0x00D7, 0x00D7, Po}, {0x00D8, 0x00DE, Lu},
+        {0x00DF, 0x00F6, Ll}, {0x00F7, 0x00F7, Po}, {0x00F8, 0x00FF, Ll}, {0x0100, 0x0137, LuLl},
+        {0x0138, 0x0138, Ll}, {0x0139, 0x0148, LuLl}, {0x0149, 0x0149, Ll}, {0x014A, 0x0177, LuLl},
+        {0x0178, 0x0179, Lu}, {0x017A, 0x017A, Ll}, {0x017B, 0x017E, LuLl}, {0x017F, 0x0180, Ll},
+        {0x0181, 0x0182, Lu}, {0x0183, 0x0183, Ll}, {0x0184, 0x0184, Lu}, {0x0185, 0x0185, Ll}, {0x0186, 0x0187, Lu},
+        {0x0188, 0x0188, Ll}, {0x0189, 0x018B, Lu}, {0x018C, 0x018D, Ll}, {0x018E, 0x0191, Lu}, {0x0192, 0x0192, Ll},
+        {0x0193, 0x0194, Lu}, {0x0195, 0x0195, Ll}, {0x0196, 0x0198, Lu}, {0x0199, 0x019B, Ll}, {0x019C, 0x019D, Lu},
+        {0x019E, 0x019E, Ll}, {0x019F, 0x01A0, Lu}, {0x01A1, 0x01A1, Ll}, {0x01A2, 0x01A5, LuLl},
+        {0x01A6, 0x01A7, Lu}, {0x01A8, 0x01A8, Ll}, {0x01A9, 0x01A9, Lu}, {0x01AA, 0x01AB, Ll}, {0x01AC, 0x01AC, Lu},
+        {0x01AD, 0x01AD, Ll}, {0x01AE, 0x01AF, Lu}, {0x01B0, 0x01B0, Ll}, {0x01B1, 0x01B3, Lu}, {0x01B4, 0x01B4, Ll},
+        {0x01B5, 0x01B5, Lu}, {0x01B6, 0x01B6, Ll}, {0x01B7, 0x01B8, Lu}, {0x01B9, 0x01BA, Ll}, {0x01BB, 0x01BB, Lo},
+        {0x01BC, 0x01BC, Lu}, {0x01BD, 0x01BF, Ll}, {0x01C0, 0x01C3, Lo}, {0x01C4, 0x01C5, Lu}, {0x01C6, 0x01C6, Ll},
+        {0x01C7, 0x01C8, Lu}, {0x01C9, 0x01C9, Ll}, {0x01CA, 0x01CB, Lu}, {0x01CC, 0x01CC, Ll},
+        {0x01CD, 0x01DC, LuLl}, {0x01DD, 0x01DD, Ll}, {0x01DE, 0x01EF, LuLl}, {0x01F0, 0x01F0, Ll},
+        {0x01F1, 0x01F2, Lu}, {0x01F3, 0x01F3, Ll}, {0x01F4, 0x01F4, Lu}, {0x01F5, 0x01F5, Ll}, {0x01F6, 0x01F8, Lu},
+        {0x01F9, 0x01F9, Ll}, {0x01FA, 0x0233, LuLl}, {0x0234, 0x0239, Ll}, {0x023A, 0x023B, Lu},
+        {0x023C, 0x023C, Ll}, {0x023D, 0x023E, Lu}, {0x023F, 0x0240, Ll}, {0x0241, 0x0241, Lu}, {0x0242, 0x0242, Ll},
+        {0x0243, 0x0246, Lu}, {0x0247, 0x0247, Ll}, {0x0248, 0x024F, LuLl}, {0x0250, 0x0293, Ll},
+        {0x0294, 0x0295, Lo}, {0x0296, 0x02AF, Ll}, {0x02B0, 0x02C1, Lo}, {0x02C2, 0x02C5, Po}, {0x02C6, 0x02D1, Lo},
+        {0x02D2, 0x02DF, Po}, {0x02E0, 0x02E4, Lo}, {0x02E5, 0x02EB, Po}, {0x02EC, 0x02EC, Lo}, {0x02ED, 0x02ED, Po},
+        {0x02EE, 0x02EE, Lo}, {0x02EF, 0x02FF, Po}, {0x0300, 0x036F, Mn}, {0x0370, 0x0373, LuLl},
+        {0x0374, 0x0374, Lo}, {0x0375, 0x0375, Po}, {0x0376, 0x0379, LuLl}, {0x037A, 0x037A, Lo},
+        {0x037B, 0x037D, Ll}, {0x037E, 0x037E, Po}, {0x037F, 0x0382, LuLl}, {0x0383, 0x0385, Po},
+        {0x0386, 0x0386, Lu}, {0x0387, 0x0387, Po}, {0x0388, 0x038F, Lu}, {0x0390, 0x0390, Ll}, {0x0391, 0x03AB, Lu},
+        {0x03AC, 0x03CE, Ll}, {0x03CF, 0x03CF, Lu}, {0x03D0, 0x03D1, Ll}, {0x03D2, 0x03D4, Lu}, {0x03D5, 0x03D7, Ll},
+        {0x03D8, 0x03EF, LuLl}, {0x03F0, 0x03F3, Ll}, {0x03F4, 0x03F4, Lu}, {0x03F5, 0x03F5, Ll},
+        {0x03F6, 0x03F6, Po}, {0x03F7, 0x03F7, Lu}, {0x03F8, 0x03F8, Ll}, {0x03F9, 0x03FA, Lu}, {0x03FB, 0x03FC, Ll},
+        {0x03FD, 0x042F, Lu}, {0x0430, 0x045F, Ll}, {0x0460, 0x0481, LuLl}, {0x0482, 0x0482, Po},
+        {0x0483, 0x0489, Mn}, {0x048A, 0x04BF, LuLl}, {0x04C0, 0x04C1, Lu}, {0x04C2, 0x04C2, Ll},
+        {0x04C3, 0x04CE, LuLl}, {0x04CF, 0x04CF, Ll}, {0x04D0, 0x052F, LuLl}, {0x0530, 0x0557, Lu},
+        {0x0558, 0x0559, Lo}, {0x055A, 0x055F, Po}, {0x0560, 0x0588, Ll}, {0x0589, 0x058A, Po}, {0x058B, 0x058C, Lo},
+        {0x058D, 0x058F, Po}, {0x10A0, 0x10CF, Lu}, {0x10D0, 0x10FA, Ll}, {0x10FB, 0x10FB, Po}, {0x10FC, 0x10FC, Lo},
+        {0x10FD, 0x10FF, Ll}, {0x1C80, 0x1C88, Ll}, {0x1C89, 0x1C8E, LuLl}, {0x1C8F, 0x1CBF, Lu},
+        {0x1D00, 0x1D2B, Ll}, {0x1D2C, 0x1D6A, Lo}, {0x1D6B, 0x1D77, Ll}, {0x1D78, 0x1D78, Lo}, {0x1D79, 0x1D9A, Ll},
+        {0x1D9B, 0x1DBF, Lo}, {0x1E00, 0x1E95, LuLl}, {0x1E96, 0x1E9D, Ll}, {0x1E9E, 0x1EFF, LuLl},
+        {0x1F00, 0x1F07, Ll}, {0x1F08, 0x1F0F, Lu}, {0x1F10, 0x1F17, Ll}, {0x1F18, 0x1F1F, Lu}, {0x1F20, 0x1F27, Ll},
+        {0x1F28, 0x1F2F, Lu}, {0x1F30, 0x1F37, Ll}, {0x1F38, 0x1F3F, Lu}, {0x1F40, 0x1F47, Ll}, {0x1F48, 0x1F4F, Lu},
+        {0x1F50, 0x1F58, Ll}, {0x1F59, 0x1F60, LuLl}, {0x1F61, 0x1F67, Ll}, {0x1F68, 0x1F6F, Lu},
+        {0x1F70, 0x1F87, Ll}, {0x1F88, 0x1F8F, Lu}, {0x1F90, 0x1F97, Ll}, {0x1F98, 0x1F9F, Lu}, {0x1FA0, 0x1FA7, Ll},
+        {0x1FA8, 0x1FAF, Lu}, {0x1FB0, 0x1FB7, Ll}, {0x1FB8, 0x1FBC, Lu}, {0x1FBD, 0x1FBD, Po}, {0x1FBE, 0x1FBE, Ll},
+        {0x1FBF, 0x1FC1, Po}, {0x1FC2, 0x1FC7, Ll}, {0x1FC8, 0x1FCC, Lu}, {0x1FCD, 0x1FCF, Po}, {0x1FD0, 0x1FD7, Ll},
+        {0x1FD8, 0x1FDC, Lu}, {0x1FDD, 0x1FDF, Po}, {0x1FE0, 0x1FE7, Ll}, {0x1FE8, 0x1FEC, Lu}, {0x1FED, 0x1FF1, Po},
+        {0x1FF2, 0x1FF7, Ll}, {0x1FF8, 0x1FFC, Lu}, {0x1FFD, 0x1FFF, Po}, {0x2183, 0x2183, Lu}, {0x2184, 0x2184, Ll},
+        {0x2C60, 0x2C60, Lu}, {0x2C61, 0x2C61, Ll}, {0x2C62, 0x2C64, Lu}, {0x2C65, 0x2C66, Ll},
+        {0x2C67, 0x2C6C, LuLl}, {0x2C6D, 0x2C70, Lu}, {0x2C71, 0x2C71, Ll}, {0x2C72, 0x2C72, Lu},
+        {0x2C73, 0x2C74, Ll}, {0x2C75, 0x2C75, Lu}, {0x2C76, 0x2C7B, Ll}, {0x2C7C, 0x2C7D, Lo}, {0x2C7E, 0x2C7F, Lu},
+        {0xA640, 0xA66D, LuLl}, {0xA66E, 0xA66E, Lo}, {0xA66F, 0xA672, Mn}, {0xA673, 0xA673, Po},
+        {0xA674, 0xA67D, Mn}, {0xA67E, 0xA67E, Po}, {0xA67F, 0xA67F, Lo}, {0xA680, 0xA69B, LuLl},
+        {0xA69C, 0xA69D, Lo}, {0xA69E, 0xA69F, Mn}, {0xA720, 0xA721, Po}, {0xA722, 0xA72F, LuLl},
+        {0xA730, 0xA731, Ll}, {0xA732, 0xA76F, LuLl}, {0xA770, 0xA770, Lo}, {0xA771, 0xA778, Ll},
+        {0xA779, 0xA77C, LuLl}, {0xA77D, 0xA77E, Lu}, {0xA77F, 0xA77F, Ll}, {0xA780, 0xA787, LuLl},
+        {0xA788, 0xA788, Lo}, {0xA789, 0xA78A, Po}, {0xA78B, 0xA78E, LuLl}, {0xA78F, 0xA78F, Lo},
+        {0xA790, 0xA793, LuLl}, {0xA794, 0xA795, Ll}, {0xA796, 0xA7A9, LuLl}, {0xA7AA, 0xA7AE, Lu},
+        {0xA7AF, 0xA7AF, Ll}, {0xA7B0, 0xA7B4, Lu}, {0xA7B5, 0xA7B5, Ll}, {0xA7B6, 0xA7C3, LuLl},
+        {0xA7C4, 0xA7C7, Lu}, {0xA7C8, 0xA7C8, Ll}, {0xA7C9, 0xA7C9, Lu}, {0xA7CA, 0xA7CA, Ll}, {0xA7CB, 0xA7CC, Lu},
+        {0xA7CD, 0xA7CD, Ll}, {0xA7CE, 0xA7DB, LuLl}, {0xA7DC, 0xA7F0, Lu}, {0xA7F1, 0xA7F4, Lo},
+        {0xA7F5, 0xA7F5, Lu}, {0xA7F6, 0xA7F6, Ll}, {0xA7F7, 0xA7F9, Lo}, {0xA7FA, 0xA7FA, Ll}, {0xA7FB, 0xA7FF, Lo},
+        {0xAB30, 0xAB5A, Ll}, {0xAB5B, 0xAB5B, Po}, {0xAB5C, 0xAB5F, Lo}, {0xAB60, 0xAB68, Ll}, {0xAB69, 0xAB69, Lo},
+        {0xAB6A, 0xAB6B, Po}, {0xAB6C, 0xAB6F, Lu}, {0xFF21, 0xFF3A, Lu}, {0xFF3B, 0xFF40, Po}, {0xFF41, 0xFF5A, Ll}
+    };
+
+    /// First codepoint of each run of ten Nd digits outside ASCII
+    static constexpr uint32_t decimal_digits[] = {
+        0x660, 0x6F0, 0x7C0, 0x966, 0x9E6, 0xA66, 0xAE6, 0xB66, 0xBE6, 0xC66, 0xCE6, 0xD66, 0xDE6, 0xE50, 0xED0,
+        0xF20, 0x1040, 0x1090, 0x17E0, 0x1810, 0x1946, 0x19D0, 0x1A80, 0x1A90, 0x1B50, 0x1BB0, 0x1C40, 0x1C50, 0xA620,
+        0xA8D0, 0xA900, 0xA9D0, 0xA9F0, 0xAA50, 0xABF0, 0xFF10, 0x104A0, 0x10D30, 0x10D40, 0x11066, 0x110F0, 0x11136,
+        0x111D0, 0x112F0, 0x11450, 0x114D0, 0x11650, 0x116C0, 0x116D0, 0x116DA, 0x11730, 0x118E0, 0x11950, 0x11BF0,
+        0x11C50, 0x11D50, 0x11DA0, 0x11DE0, 0x11F50, 0x16130, 0x16A60, 0x16AC0, 0x16B50, 0x16D70, 0x1CCF0, 0x1D7CE,
+        0x1D7D8, 0x1D7E2, 0x1D7EC, 0x1D7F6, 0x1E140, 0x1E2F0, 0x1E4F0, 0x1E5F1, 0x1E950, 0x1FBF0
+    };
+
+    /// \p{N}: Nd digits, and the Nl and No numbers of common text
+    static bool is_number(uint32_t cp) {
+        auto next = std::upper_bound(std::begin(decimal_digits), std::end(decimal_digits), cp);
+        if (next != std::begin(decimal_digits) && cp - *std::prev(next) < 10) {
+            return true;
+        }
+        return cp == 0xB2 || cp == 0xB3 || cp == 0xB9 || (cp >= 0xBC && cp <= 0xBE) || cp == 0x2070 ||
+            (cp >= 0x2074 && cp <= 0x2079) || (cp >= 0x2080 && cp <= 0x2089) || (cp >= 0x2150 && cp <= 0x2182) ||
+            (cp >= 0x2185 && cp <= 0x2189) || (cp >= 0x2460 && cp <= 0x249B) || (cp >= 0x24EA && cp <= 0x24FF) ||
+            (cp >= 0x2776 && cp <= 0x2793) || cp == 0x3007 || (cp >= 0x3021 && cp <= 0x3029) ||
+            (cp >= 0x3038 && cp <= 0x303A) || (cp >= 0x3192 && cp <= 0x3195) || (cp >= 0x3220 && cp <= 0x3229) ||
+            (cp >= 0x3248 && cp <= 0x324F) || (cp >= 0x3251 && cp <= 0x325F) || (cp >= 0x3280 && cp <= 0x3289) ||
+            (cp >= 0x32B1 && cp <= 0x32BF);
+    }
+
+    /// Class from the letter runs, nullopt outside them
+    static std::optional<char_class> letter_run_class(uint32_t cp) {
+        auto next = std::upper_bound(std::begin(letter_runs), std::end(letter_runs), cp,
+            [](uint32_t value, const letter_run& run) { return value < run.first; });
+        if (next == std::begin(letter_runs) || cp > std::prev(next)->last) {
+            return std::nullopt;
+        }
+        const letter_run& run = *std::prev(next);
+        switch (run.category) {
+            case Lu: return char_class::upper;
+            case Ll: return char_class::lower;
+            case Lo: return char_class::letter;
+            case Mn: return char_class::mark;
+            case Po: return char_class::other;
+            case LuLl: return (cp - run.first) % 2 == 0 ? char_class::upper : char_class::lower;
+        }
+        return std::nullopt;
+    }
+
+    static char_class classify(uint32_t cp) {
+        if (cp < 0x80) {
+            if (cp >= 'a' && cp <= 'z') return char_class::lower;
+            if (cp >= 'A' && cp <= 'Z') return char_class::upper;
+            if (cp >= '0' && cp <= '9') return char_class::digit;
+            if (cp == '\r' || cp == '\n') return char_class::newline;
+            if (cp == ' ' || cp == '\t' || cp == '\v' || cp == '\f') return char_class::space;
+            if (cp == '\'') return char_class::apostrophe;
+            return char_class::other;
+        }
+        if (cp == 0x85) return char_class::space;
+        if (cp == 0xA0 || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200A) || cp == 0x2028 || cp == 0x2029 ||
+            cp == 0x202F || cp == 0x205F || cp == 0x3000) {
+            return char_class::space;
+        }
+        if (is_number(cp)) {
+            return char_class::digit;
+        }
+        if (auto cls = letter_run_class(cp)) {
+            return *cls;
+        }
+        if ((cp >= 0x0300 && cp <= 0x036F) || (cp >= 0x0483 && cp <= 0x0489) || (cp >= 0x1AB0 && cp <= 0x1AFF) ||
+            (cp >= 0x1DC0 && cp <= 0x1DFF) || (cp >= 0x20D0 && cp <= 0x20FF) || (cp >= 0xFE00 && cp <= 0xFE0F) ||
+            (cp >= 0xFE20 && cp <= 0xFE2F) || (cp >= 0xE0100 && cp <= 0xE01EF)) {
+            return char_class::mark;
+        }
+        if ((cp >= 0x200B && cp <= 0x2027) || (cp >= 0x202A && cp <= 0x202E) || (cp >= 0x2030 && cp <= 0x205E) ||
+            (cp >= 0x2060 && cp <= 0x206F) || (cp >= 0x207A && cp <= 0x207E) || (cp >= 0x208A && cp <= 0x208E) ||
+            (cp >= 0x20A0 && cp <= 0x20CF) ||
+            (cp >= 0x218A && cp <= 0x2BFF) || (cp >= 0x2E00 && cp <= 0x2E7F) || (cp >= 0x3001 && cp <= 0x3003) ||
+            (cp >= 0x3008 && cp <= 0x3020) || cp == 0x30FB || (cp >= 0xFF01 && cp <= 0xFF0F) ||
+            (cp >= 0xFF1A && cp <= 0xFF20) || (cp >= 0xFF3B && cp <= 0xFF40) || (cp >= 0xFF5B && cp <= 0xFF65) ||
+            (cp >= 0x1F000 && cp <= 0x1FAFF) || cp == 0xFFFD) {
+            return char_class::other;
+        }
+        /// Like \p{Lo}, in both the upper and the lower case sets of o200k
+        return char_class::letter;
+    }
+
+    /// Codepoints and their byte offsets; ASCII text skips the decoding
+    struct text_view {
+        std::string_view bytes;
+        std::vector<uint32_t> codepoints;
+        std::vector<uint32_t> offsets;
+        bool ascii;
+
+        explicit text_view(std::string_view text) : bytes(text), ascii(is_ascii(text)) {
+            if (ascii) {
+                return;
+            }
+            codepoints.reserve(text.size());
+            offsets.reserve(text.size() + 1);
+            size_t i = 0;
+            while (i < text.size()) {
+                unsigned char c = static_cast<unsigned char>(text[i]);
+                size_t length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 1;
+                if (i + length > text.size()) {
+                    length = 1;
+                }
+                uint32_t cp = length == 1 ? c : c & (0xFF >> (length + 1));
+                for (size_t k = 1; k < length; ++k) {
+                    cp = (cp << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3F);
+                }
+                codepoints.push_back(cp);
+                offsets.push_back(static_cast<uint32_t>(i));
+                i += length;
+            }
+            offsets.push_back(static_cast<uint32_t>(text.size()));
+        }
+
+        size_t size() const { return ascii ? bytes.size() : codepoints.size(); }
+        uint32_t at(size_t i) const { return ascii ? static_cast<unsigned char>(bytes[i]) : codepoints[i]; }
+        size_t offset(size_t i) const { return ascii ? i : offsets[i]; }
+        char_class cls(size_t i) const { return classify(at(i)); }
+    };
+
+    static bool is_letter(char_class c) { return c == char_class::upper || c == char_class::lower || c == char_class::letter; }
+    static bool is_whitespace(char_class c) { return c == char_class::space || c == char_class::newline; }
+
+    /// Letters of o200k's [\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}] and [\p{Ll}\p{Lm}\p{Lo}\p{M}]
+    static bool upper_set(const text_view& t, size_t i) {
+        char_class c = t.cls(i);
+        return c == char_class::upper || c == char_class::letter || c == char_class::mark;
+    }
+    static bool lower_set(const text_view& t, size_t i) {
+        char_class c = t.cls(i);
+        return c == char_class::lower || c == char_class::letter || c == char_class::mark;
+    }
+    static bool cased_set(const text_view& t, size_t i) { return upper_set(t, i) || lower_set(t, i); }
+
+    /// (?i:'s|'t|'re|'ve|'m|'ll|'d) at i, returns its length or 0
+    static size_t contraction(const text_view& t, size_t i) {
+        if (i >= t.size() || t.cls(i) != char_class::apostrophe || i + 1 >= t.size()) {
+            return 0;
+        }
+        auto lower = [&t](size_t k) -> uint32_t {
+            uint32_t c = t.at(k);
+            return c >= 'A' && c <= 'Z' ? c + 32 : c;
+        };
+        uint32_t a = lower(i + 1);
+        if (a == 's' || a == 't' || a == 'm' || a == 'd') {
+            return 2;
+        }
+        if (i + 2 < t.size()) {
+            uint32_t b = lower(i + 2);
+            if ((a == 'r' && b == 'e') || (a == 'v' && b == 'e') || (a == 'l' && b == 'l')) {
+                return 3;
+            }
+        }
+        return 0;
+    }
+
+    /// \s*[\r\n]+ | \s+(?!\S) | \s+ at i, where i is whitespace
+    static size_t whitespace_piece(const text_view& t, size_t i) {
+        size_t end = i;
+        size_t last_newline = 0;
+        bool newline = false;
+        while (end < t.size() && is_whitespace(t.cls(end))) {
+            if (t.cls(end) == char_class::newline) {
+                last_newline = end;
+                newline = true;
+            }
+            ++end;
+        }
+        if (newline) {
+            return last_newline + 1 - i;
+        }
+        if (end == t.size() || end - i == 1) {
+            return end - i;
+        }
+        /// Leave the last space to prefix the next word
+        return end - i - 1;
+    }
+
+    /// Optional [^\r\n\p{L}\p{N}] prefix before letters
+    static bool letter_prefix(const text_view& t, size_t i) {
+        char_class c = t.cls(i);
+        return c != char_class::newline && c != char_class::digit && !is_letter(c) &&
+            i + 1 < t.size() && is_letter(t.cls(i + 1));
+    }
+
+    static size_t cl100k_piece(const text_view& t, size_t i) {
+        char_class c = t.cls(i);
+        if (size_t length = contraction(t, i)) {
+            return length;
+        }
+        if (is_letter(c) || letter_prefix(t, i)) {
+            size_t end = i + 1;
+            while (end < t.size() && is_letter(t.cls(end))) ++end;
+            return end - i;
+        }
+        if (c == char_class::digit) {
+            size_t end = i + 1;
+            while (end < t.size() && end - i < 3 && t.cls(end) == char_class::digit) ++end;
+            return end - i;
+        }
+        /// ' ?[^\s\p{L}\p{N}]+[\r\n]*'
+        size_t start = i + (t.at(i) == ' ' && i + 1 < t.size() && !is_whitespace(t.cls(i + 1)) &&
+            !is_letter(t.cls(i + 1)) && t.cls(i + 1) != char_class::digit ? 1 : 0);
+        if (!is_whitespace(t.cls(start))) {
+            size_t end = start;
+            while (end < t.size() && !is_whitespace(t.cls(end)) && !is_letter(t.cls(end)) && t.cls(end) != char_class::digit) ++end;
+            while (end < t.size() && t.cls(end) == char_class::newline) ++end;
+            return end - i;
+        }
+        /// \s++$ takes trailing whitespace whole
+        size_t end = i;
+        while (end < t.size() && is_whitespace(t.cls(end))) ++end;
+        if (end == t.size()) {
+            return end - i;
+        }
+        return whitespace_piece(t, i);
+    }
+
+    static size_t o200k_piece(const text_view& t, size_t i) {
+        char_class c = t.cls(i);
+        /// Marks join letter runs here, and may also be the prefix
+        bool prefix = c != char_class::newline && c != char_class::digit && !is_letter(c) &&
+            i + 1 < t.size() && cased_set(t, i + 1);
+        size_t start = i + (prefix ? 1 : 0);
+        if (start < t.size() && cased_set(t, start)) {
+            /// [upper]*[lower]+ first, then [upper]+[lower]*, each with an optional contraction
+            size_t upper_end = start;
+            while (upper_end < t.size() && upper_set(t, upper_end)) ++upper_end;
+            size_t end = upper_end;
+            while (end < t.size() && lower_set(t, end)) ++end;
+            if (end == upper_end) {
+                /// [upper]*[lower]+ backtracks to the last caseless letter of the
+                /// capitals, without one [upper]+[lower]* takes them all
+                size_t back = upper_end;
+                while (back > start && t.cls(back - 1) != char_class::letter && t.cls(back - 1) != char_class::mark) --back;
+                if (back > start) {
+                    end = back;
+                } else if (prefix && c == char_class::mark) {
+                    /// Without the prefix, the mark alone is [upper]*[lower]+
+                    end = i + 1;
+                } else {
+                    end = upper_end;
+                }
+            }
+            return end - i + contraction(t, end);
+        }
+        if (c == char_class::digit) {
+            size_t end = i + 1;
+            while (end < t.size() && end - i < 3 && t.cls(end) == char_class::digit) ++end;
+            return end - i;
+        }
+        /// ' ?[^\s\p{L}\p{N}]+[\r\n/]*'
+        size_t symbol = i + (t.at(i) == ' ' && i + 1 < t.size() && !is_whitespace(t.cls(i + 1)) &&
+            !is_letter(t.cls(i + 1)) && t.cls(i + 1) != char_class::digit ? 1 : 0);
+        if (!is_whitespace(t.cls(symbol))) {
+            size_t end = symbol;
+            while (end < t.size() && !is_whitespace(t.cls(end)) && !is_letter(t.cls(end)) && t.cls(end) != char_class::digit) ++end;
+            while (end < t.size() && (t.cls(end) == char_class::newline || t.at(end) == '/')) ++end;
+            return end - i;
+        }
+        return whitespace_piece(t, i);
+    }
+
+    template <typename Callback>
+    static void for_each_piece(std::string_view text, encoding pattern, Callback&& callback) {
+        text_view view(text);
+        for (size_t i = 0; i < view.size();) {
+            size_t length = pattern == encoding::o200k_base ? o200k_piece(view, i) : cl100k_piece(view, i);
+            length = std::max<size_t>(length, 1);
+            size_t end = std::min(i + length, view.size());
+            callback(text.substr(view.offset(i), view.offset(end) - view.offset(i)));
+            i = end;
+        }
+    }
+
+    uint32_t rank(std::string_view bytes) const {
+        auto found = ranks.find(bytes);
+        return found == ranks.end() ? no_rank : found->second;
+    }
+
+    /// Merges the lowest ranked adjacent pair until none is in the vocabulary
+    void merge(std::string_view piece, std::vector<uint32_t>& tokens) const {
+        if (uint32_t whole = rank(piece); whole != no_rank) {
+            tokens.push_back(whole);
+            return;
+        }
+        std::vector<std::pair<size_t, uint32_t>> parts;
+        parts.reserve(piece.size() + 1);
+        for (size_t i = 0; i + 1 < piece.size(); ++i) {
+            parts.emplace_back(i, rank(piece.substr(i, 2)));
+        }
+        parts.emplace_back(piece.size() - 1, no_rank);
+        parts.emplace_back(piece.size(), no_rank);
+
+        auto pair_rank = [&](size_t i) {
+            if (i + 3 < parts.size()) {
+                return rank(piece.substr(parts[i].first, parts[i + 3].first - parts[i].first));
+            }
+            return no_rank;
+        };
+        while (parts.size() > 1) {
+            size_t best = 0;
+            uint32_t best_rank = no_rank;
+            for (size_t i = 0; i + 1 < parts.size(); ++i) {
+                if (parts[i].second < best_rank) {
+                    best_rank = parts[i].second;
+                    best = i;
+                }
+            }
+            if (best_rank == no_rank) {
+                break;
+            }
+            if (best > 0) {
+                parts[best - 1].second = pair_rank(best - 1);
+            }
+            parts[best].second = pair_rank(best);
+            parts.erase(parts.begin() + static_cast<std::ptrdiff_t>(best) + 1);
+        }
+        for (size_t i = 0; i + 1 < parts.size(); ++i) {
+            uint32_t token = rank(piece.substr(parts[i].first, parts[i + 1].first - parts[i].first));
+            /// Every byte is in cl100k and o200k; a foreign vocabulary may miss some
+            if (token != no_rank) {
+                tokens.push_back(token);
+            }
+        }
+    }
+
+    static std::string decode_base64(std::string_view text) {
+        static const auto table = [] {
+            std::array<int8_t, 256> t;
+            t.fill(-1);
+            const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            for (int i = 0; i < 64; ++i) t[static_cast<unsigned char>(alphabet[i])] = static_cast<int8_t>(i);
+            return t;
+        }();
+        std::string result;
+        result.reserve(text.size() * 3 / 4);
+        uint32_t buffer = 0;
+        int bits = 0;
+        for (unsigned char c : text) {
+            if (table[c] < 0) {
+                continue;   /// Padding
+            }
+            buffer = (buffer << 6) | static_cast<uint32_t>(table[c]);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                result.push_back(static_cast<char>((buffer >> bits) & 0xFF));
+            }
+        }
+        return result;
+    }
+
+public:
+    Tokenizer(const Tokenizer&) = delete;
+    Tokenizer& operator=(const Tokenizer&) = delete;
+
+    static Tokenizer* get_instance() {
+        static Tokenizer instance;
+        return &instance;
+    }
+
+    /// True if every byte is ASCII, 16 bytes per step
+    static bool is_ascii(std::string_view text) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        __m128i any = _mm_setzero_si128();
+        for (; i + 16 <= text.size(); i += 16) {
+            any = _mm_or_si128(any, _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i)));
+        }
+        if (_mm_movemask_epi8(any) != 0) {
+            return false;
+        }
+#endif
+        for (; i < text.size(); ++i) {
+            if (static_cast<unsigned char>(text[i]) >= 0x80) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Load a .tiktoken vocabulary; call before other threads tokenize
+    /// @param filename Path to the vocabulary, e.g. cl100k_base.tiktoken
+    /// @param name "cl100k_base" or "o200k_base", selects the split pattern
+    void load(const std::string& filename, const std::string& name) {
+        guard("Tokenizer::load")
+        if (name != "cl100k_base" && name != "o200k_base") {
+            throw std::runtime_error("Unsupported encoding '" + name + "'");
+        }
+        std::ifstream file(filename);
+        if (!file) {
+            throw std::runtime_error("Failed to open vocabulary " + filename);
+        }
+        ranks.clear();
+        ranks.reserve(name == "o200k_base" ? 200000 : 100000);
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t space = line.find(' ');
+            if (space == std::string::npos) {
+                continue;
+            }
+            ranks.emplace(decode_base64(std::string_view(line).substr(0, space)),
+                static_cast<uint32_t>(std::stoul(line.substr(space + 1))));
+        }
+        pattern = name == "o200k_base" ? encoding::o200k_base : encoding::cl100k_base;
+        ready = !ranks.empty();
+        unguard()
+    }
+
+    bool loaded() const {
+        return ready;
+    }
+
+    std::vector<uint32_t> encode(std::string_view text) const {
+        std::vector<uint32_t> tokens;
+        if (!ready || text.empty()) {
+            return tokens;
+        }
+        tokens.reserve(text.size() / 3 + 1);
+        for_each_piece(text, pattern, [&](std::string_view piece) { merge(piece, tokens); });
+        return tokens;
+    }
+
+    /// Pre-tokenization pieces of the text, as the encoding's pattern splits it
+    static std::vector<std::string_view> split(std::string_view text, encoding pattern) {
+        std::vector<std::string_view> pieces;
+        for_each_piece(text, pattern, [&](std::string_view piece) { pieces.push_back(piece); });
+        return pieces;
+    }
+
+    /// Token count, or the bytes / 4 estimate without a vocabulary
+    size_t count(std::string_view text) const {
+        if (!ready) {
+            return text.size() / 4 + 1;
+        }
+        return encode(text).size();
+    }
+};
@@ -9,7 +9,7 @@ void ToolRegistry::register_tool(const std::string& name, function_t func) {
 std::optional<std::string> ToolRegistry::call_tool(const std::string& name, const json& args) {
     auto it = tools.find(name);
     if (it != tools.end()) {
-        return it->second(ce_ref, args);  // Pass the shared_ptr
+        return it->second(ce_ref.lock(), args);  // Pass the shared_ptr
     }
     return std::nullopt;
 }
@@ -11,8 +11,8 @@ using function_t = std::function<std::string(std::shared_ptr<AgentExecutor>, con
 ///
 class ToolRegistry {
 private:
-    ///
-    std::shared_ptr<AgentExecutor> ce_ref;
+    /// Weak, the executor owns the registry
+    std::weak_ptr<AgentExecutor> ce_ref;
     std::unordered_map<std::string, function_t> tools;
 
 public:
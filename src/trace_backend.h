@@ -0,0 +1,409 @@
+#pragma once
+
+#include "llm_backend.h"
+
+#include <cstring>
+
+/*
+    LLM traffic trace format
+
+    some_run.trace
+    -----------------------
+    header      "MTRC", format version (u32)
+    record      length (u32), MessagePack object:
+                kind        "chat" or "embedding"
+                key         hash of the request
+                latency_ms  time the response took
+                status      HTTP status, 0 if the request failed without a response
+                body        response body, or the SSE chunks of a streamed one
+                retry_after_ms  Retry-After of a 429 response (optional)
+
+    Records are only appended; a torn record at the tail is ignored.
+*/
+
+///
+/// @brief Request/response trace file shared by recording and replay
+///
+class TraceFile {
+public:
+    struct record {
+        std::string kind;
+        std::string key;
+        double latency_ms;
+        long status;
+        std::string body;
+        long retry_after_ms{-1};
+    };
+
+private:
+    static constexpr char magic[4] = {'M', 'T', 'R', 'C'};
+    static constexpr uint32_t version = 1;
+
+public:
+    static std::string chat_key(const std::string& model, const liboai::Conversation& conversation,
+        float temperature, const std::vector<std::string>& stop, bool stream) {
+        fnv_hasher h;
+        h.update("chat");
+        h.update(model);
+        h.update(fmt::format("{}", temperature));
+        for (const auto& sequence : stop) {
+            h.update(sequence);
+        }
+        h.update(stream ? "stream" : "batch");
+        for (const auto& message : conversation.GetSerializedMessages()) {
+            h.update(*message);
+        }
+        return h.hex();
+    }
+
+    static std::string embedding_key(embedding_model model, const std::vector<std::string>& texts) {
+        fnv_hasher h;
+        h.update("embedding");
+        h.update(fmt::format("{}", model));
+        for (const auto& text : texts) {
+            h.update(text);
+        }
+        return h.hex();
+    }
+
+    /// @brief Append one record, writing the header to a new file
+    static void append(std::ofstream& file, const record& item) {
+        if (file.tellp() == 0) {
+            uint32_t head_version = version;
+            file.write(magic, sizeof(magic));
+            file.write(reinterpret_cast<const char*>(&head_version), sizeof(head_version));
+        }
+        json fields = {
+            {"kind", item.kind},
+            {"key", item.key},
+            {"latency_ms", item.latency_ms},
+            {"status", item.status},
+            {"body", item.body}
+        };
+        if (item.retry_after_ms >= 0) {
+            fields["retry_after_ms"] = item.retry_after_ms;
+        }
+        std::vector<uint8_t> payload = json::to_msgpack(fields);
+        uint32_t length = static_cast<uint32_t>(payload.size());
+        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        file.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+        file.flush();
+    }
+
+    /// @brief Read every complete record of a trace
+    static std::vector<record> load(const std::string& filename) {
+        std::string content = read_file(filename);
+        size_t head = sizeof(magic) + sizeof(uint32_t);
+        uint32_t file_version = 0;
+        if (content.size() < head || std::memcmp(content.data(), magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("Not a trace file: " + filename);
+        }
+        std::memcpy(&file_version, content.data() + sizeof(magic), sizeof(file_version));
+        if (file_version != version) {
+            throw std::runtime_error("Unsupported trace version in " + filename);
+        }
+        std::vector<record> records;
+        size_t offset = head;
+        while (offset + sizeof(uint32_t) <= content.size()) {
+            uint32_t length;
+            std::memcpy(&length, content.data() + offset, sizeof(length));
+            offset += sizeof(length);
+            if (offset + length > content.size()) {
+                break;
+            }
+            json item = json::from_msgpack(content.begin() + offset, content.begin() + offset + length, true, false);
+            offset += length;
+            if (item.is_discarded()) {
+                break;
+            }
+            records.push_back(record{
+                item.at("kind").get<std::string>(),
+                item.at("key").get<std::string>(),
+                item.at("latency_ms").get<double>(),
+                item.at("status").get<long>(),
+                item.at("body").get<std::string>(),
+                item.value("retry_after_ms", -1L)
+            });
+        }
+        return records;
+    }
+};
+
+///
+/// @brief Writes every request and response of another backend to a trace
+///
+class RecordingBackend : public LLMBackend {
+    std::shared_ptr<LLMBackend> inner;
+    std::mutex mutex;
+    std::ofstream file;
+    uint64_t recorded{0};
+
+    using clock = std::chrono::steady_clock;
+
+    static double since(clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+
+    void write(std::string kind, std::string key, double latency_ms, long status, std::string body, long retry_after_ms = -1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceFile::append(file, {std::move(kind), std::move(key), latency_ms, status, std::move(body), retry_after_ms});
+        recorded++;
+    }
+
+    ///
+    /// Runs the request and records its response, or its failure with the
+    /// status and body of the error response so replay fails the same way.
+    /// Cancelled requests are the caller's doing and are not recorded.
+    ///
+    template <typename Request>
+    liboai::Response record(const std::string& kind, const std::string& key, clock::time_point start,
+        Request&& request, const std::string* body = nullptr) {
+        try {
+            liboai::Response response = request();
+            write(kind, key, since(start), response.status_code, body ? *body : response.content);
+            return response;
+        } catch (...) {
+            record_error(kind, key, start, std::current_exception());
+            throw;
+        }
+    }
+
+    void record_error(const std::string& kind, const std::string& key, clock::time_point start, std::exception_ptr error) {
+        try {
+            std::rethrow_exception(error);
+        } catch (const liboai::exception::OpenAIRateLimited& e) {
+            write(kind, key, since(start), 429, e.GetBody(), e.GetRetryAfterMs());
+        } catch (const liboai::exception::OpenAIException& e) {
+            if (e.GetType() != liboai::exception::EType::E_CANCELLED) {
+                write(kind, key, since(start), e.GetStatusCode(), e.GetBody());
+            }
+        } catch (...) {
+        }
+    }
+
+    /// Records from the inner backend's completion path, then runs the caller's hook
+    CompletionHook recording_hook(std::string kind, std::string key, CompletionHook next) {
+        return CompletionHook([this, kind = std::move(kind), key = std::move(key), next = std::move(next), start = clock::now()](
+            const liboai::Response* response, std::exception_ptr error) {
+            if (response) {
+                write(kind, key, since(start), response->status_code, response->content);
+            } else {
+                record_error(kind, key, start, error);
+            }
+            next(response, std::move(error));
+        });
+    }
+
+public:
+    RecordingBackend(std::shared_ptr<LLMBackend> backend, const std::string& filename)
+        : inner(std::move(backend)), file(filename, std::ios::binary | std::ios::app) {
+        if (!file) {
+            throw std::runtime_error("Failed to open trace " + filename);
+        }
+        file.seekp(0, std::ios::end);
+    }
+
+    uint64_t get_recorded() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return recorded;
+    }
+
+    std::string endpoint() override {
+        return inner->endpoint();
+    }
+
+    liboai::Response chat_completion(const std::string& model, const liboai::Conversation& conversation,
+        float temperature, const std::vector<std::string>& stop, std::optional<StreamCallback> stream = std::nullopt) override {
+        std::string key = TraceFile::chat_key(model, conversation, temperature, stop, stream.has_value());
+        auto start = clock::now();
+        if (!stream) {
+            return record("chat", key, start, [&] {
+                return inner->chat_completion(model, conversation, temperature, stop);
+            });
+        }
+        /// The chunks the caller consumed, up to where it stopped the stream
+        std::string chunks;
+        StreamCallback callback = [&chunks, &stream](std::string data, intptr_t user) {
+            chunks += data;
+            return (*stream)(std::move(data), user);
+        };
+        return record("chat", key, start, [&] {
+            return inner->chat_completion(model, conversation, temperature, stop, callback);
+        }, &chunks);
+    }
+
+    std::future<liboai::Response> chat_completion_async(const std::string& model, const liboai::Conversation& conversation,
+        float temperature, const std::vector<std::string>& stop, CancelToken cancel, CompletionHook hook = {}) override {
+        return inner->chat_completion_async(model, conversation, temperature, stop, std::move(cancel),
+            recording_hook("chat", TraceFile::chat_key(model, conversation, temperature, stop, false), std::move(hook)));
+    }
+
+    liboai::Response embedding(embedding_model model, const std::string& text) override {
+        return record("embedding", TraceFile::embedding_key(model, {text}), clock::now(), [&] {
+            return inner->embedding(model, text);
+        });
+    }
+
+    liboai::Response embedding(embedding_model model, const std::vector<std::string>& texts) override {
+        return record("embedding", TraceFile::embedding_key(model, texts), clock::now(), [&] {
+            return inner->embedding(model, texts);
+        });
+    }
+
+    std::future<liboai::Response> embedding_async(embedding_model model, const std::string& text, CompletionHook hook = {}) override {
+        return inner->embedding_async(model, text,
+            recording_hook("embedding", TraceFile::embedding_key(model, {text}), std::move(hook)));
+    }
+
+    std::future<liboai::Response> embedding_async(embedding_model model, const std::vector<std::string>& texts, CompletionHook hook = {}) override {
+        return inner->embedding_async(model, texts,
+            recording_hook("embedding", TraceFile::embedding_key(model, texts), std::move(hook)));
+    }
+};
+
+///
+/// @brief Serves a recorded trace back, no network
+///
+/// Requests are matched by hash; repeats of a request get its recorded
+/// responses in order. A request missing from the trace (e.g. the date
+/// in the system prompt changed) gets the next unserved record of its
+/// kind instead, counted as a fallback. Recorded latencies are slept,
+/// multiplied by the latency scale (0 replays at full speed).
+///
+class ReplayBackend : public LLMBackend {
+public:
+    struct stats {
+        uint64_t replayed{0};
+        uint64_t fallbacks{0};
+    };
+
+private:
+    std::mutex mutex;
+    std::vector<TraceFile::record> records;
+    std::vector<bool> served;
+    std::unordered_map<std::string, std::deque<size_t>> by_key;
+    std::map<std::string, size_t> next_unserved;    /// Fallback cursor per kind
+    double latency_scale{1.0};
+    std::string trace;
+    stats counters;
+
+    const TraceFile::record& take(const std::string& kind, const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.replayed++;
+        auto found = by_key.find(key);
+        if (found != by_key.end() && !found->second.empty()) {
+            size_t index = found->second.front();
+            /// The last response of a request keeps answering its repeats
+            if (found->second.size() > 1) {
+                found->second.pop_front();
+            }
+            served[index] = true;
+            return records[index];
+        }
+        size_t& cursor = next_unserved[kind];
+        while (cursor < records.size() && (served[cursor] || records[cursor].kind != kind)) {
+            ++cursor;
+        }
+        if (cursor == records.size()) {
+            throw liboai::exception::OpenAIException(
+                "Request not in trace",
+                liboai::exception::EType::E_APIERROR,
+                "ReplayBackend::take()"
+            );
+        }
+        counters.fallbacks++;
+        served[cursor] = true;
+        return records[cursor];
+    }
+
+    std::chrono::microseconds delay(const TraceFile::record& item) const {
+        return std::chrono::microseconds(static_cast<long long>(item.latency_ms * latency_scale * 1000));
+    }
+
+    static bool failed(const TraceFile::record& item) {
+        return item.status < 200 || item.status >= 300;
+    }
+
+    /// A failed record throws what its response raised when recorded
+    static liboai::Response respond(const TraceFile::record& item) {
+        return liboai::Response("replay://" + item.kind, std::string(item.body),
+            fmt::format("HTTP/1.1 {}", item.status), "", item.status, item.latency_ms / 1e3, item.retry_after_ms);
+    }
+
+    std::future<liboai::Response> replay_async(const std::string& kind, const std::string& key, CompletionHook hook, CancelToken cancel = {}) {
+        const TraceFile::record& item = take(kind, key);
+        return std::async(std::launch::async, [this, &item, hook = std::move(hook), cancel = std::move(cancel)] {
+            return completing(hook, [&] {
+                wait(delay(item), cancel);
+                return respond(item);
+            });
+        });
+    }
+
+public:
+    ReplayBackend(const std::string& filename, double scale)
+        : records(TraceFile::load(filename)), served(records.size(), false), latency_scale(std::max(scale, 0.0)),
+          trace("replay:" + filename) {
+        for (size_t i = 0; i < records.size(); ++i) {
+            by_key[records[i].key].push_back(i);
+        }
+    }
+
+    stats get_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+
+    std::string endpoint() override {
+        return trace;
+    }
+
+    liboai::Response chat_completion(const std::string& model, const liboai::Conversation& conversation,
+        float temperature, const std::vector<std::string>& stop, std::optional<StreamCallback> stream = std::nullopt) override {
+        const TraceFile::record& item = take("chat", TraceFile::chat_key(model, conversation, temperature, stop, stream.has_value()));
+        if (!stream || failed(item)) {
+            wait(delay(item), CancelToken{});
+            return respond(item);
+        }
+        /// One event at a time, the latency spread over them
+        std::vector<std::string_view> events;
+        std::string_view body(item.body);
+        for (size_t start = 0; start < body.size();) {
+            size_t end = body.find("\n\n", start);
+            end = end == std::string_view::npos ? body.size() : end + 2;
+            events.push_back(body.substr(start, end - start));
+            start = end;
+        }
+        auto step = delay(item) / std::max<size_t>(events.size(), 1);
+        for (auto event : events) {
+            wait(step, CancelToken{});
+            if (!(*stream)(std::string(event), 0)) {
+                break;
+            }
+        }
+        return liboai::Response("replay://chat", "", fmt::format("HTTP/1.1 {}", item.status), "", item.status, item.latency_ms / 1e3, -1);
+    }
+
+    std::future<liboai::Response> chat_completion_async(const std::string& model, const liboai::Conversation& conversation,
+        float temperature, const std::vector<std::string>& stop, CancelToken cancel, CompletionHook hook = {}) override {
+        return replay_async("chat", TraceFile::chat_key(model, conversation, temperature, stop, false), std::move(hook), std::move(cancel));
+    }
+
+    liboai::Response embedding(embedding_model model, const std::string& text) override {
+        return embedding(model, std::vector<std::string>{text});
+    }
+
+    liboai::Response embedding(embedding_model model, const std::vector<std::string>& texts) override {
+        const TraceFile::record& item = take("embedding", TraceFile::embedding_key(model, texts));
+        wait(delay(item), CancelToken{});
+        return respond(item);
+    }
+
+    std::future<liboai::Response> embedding_async(embedding_model model, const std::string& text, CompletionHook hook = {}) override {
+        return replay_async("embedding", TraceFile::embedding_key(model, {text}), std::move(hook));
+    }
+
+    std::future<liboai::Response> embedding_async(embedding_model model, const std::vector<std::string>& texts, CompletionHook hook = {}) override {
+        return replay_async("embedding", TraceFile::embedding_key(model, texts), std::move(hook));
+    }
+};
@@ -0,0 +1,80 @@
+///
+/// Pre-tokenization split of the hand-written patterns against tiktoken.
+/// Expected pieces are the matches of the encodings' own regexes.
+///
+#include "tokenizer.h"
+
+namespace {
+
+constexpr auto o200k = Tokenizer::encoding::o200k_base;
+constexpr auto cl100k = Tokenizer::encoding::cl100k_base;
+
+struct split_case {
+    Tokenizer::encoding encoding;
+    std::string text;
+    std::vector<std::string> pieces;
+};
+
+const split_case cases[] = {
+    {o200k, "ccÉ's", {"cc", "É's"}},
+    {o200k, "aÉZ", {"a", "ÉZ"}},
+    {o200k, "٣Y", {"٣", "Y"}},
+    {o200k, "x٣٤٥٦", {"x", "٣٤٥", "٦"}},
+    {o200k, "१२३४abc", {"१२३", "४", "abc"}},
+    {o200k, "Hello, World! It's 2024.", {"Hello", ",", " World", "!", " It's", " ", "202", "4", "."}},
+    {o200k, "naïve Café déjà VU'll", {"naïve", " Café", " déjà", " VU'll"}},
+    {o200k, "ΑθήναΣ Ελλάδα's", {"Αθήνα", "Σ", " Ελλάδα's"}},
+    {o200k, "МоскваXY привет123", {"Москва", "XY", " привет", "123"}},
+    {o200k, "ǅungla ǈudi", {"ǅungla", " ǈudi"}},
+    {o200k, "Straße ÆØÅæøå", {"Straße", " ÆØÅæøå"}},
+    {o200k, "ｆｕｌｌＷＩＤＴＨ", {"ｆｕｌｌ", "ＷＩＤＴＨ"}},
+    {o200k, "ა ქართულიᲐᲑ", {"ა", " ქართული", "ᲐᲑ"}},
+    {o200k, "Ⅻ½²", {"Ⅻ½²"}},
+    {o200k, "  trailing  ", {" ", " trailing", "  "}},
+    {o200k, "line\n\n  next \n", {"line", "\n\n", " ", " next", " \n"}},
+    {o200k, "path/to/file\n", {"path", "/to", "/file", "\n"}},
+    {cl100k, "ccÉ's", {"ccÉ", "'s"}},
+    {cl100k, "aÉZ", {"aÉZ"}},
+    {cl100k, "٣Y", {"٣", "Y"}},
+    {cl100k, "x٣٤٥٦", {"x", "٣٤٥", "٦"}},
+    {cl100k, "१२३४abc", {"१२३", "४", "abc"}},
+    {cl100k, "Hello, World! It's 2024.", {"Hello", ",", " World", "!", " It", "'s", " ", "202", "4", "."}},
+    {cl100k, "naïve Café déjà VU'll", {"naïve", " Café", " déjà", " VU", "'ll"}},
+    {cl100k, "ΑθήναΣ Ελλάδα's", {"ΑθήναΣ", " Ελλάδα", "'s"}},
+    {cl100k, "МоскваXY привет123", {"МоскваXY", " привет", "123"}},
+    {cl100k, "ǅungla ǈudi", {"ǅungla", " ǈudi"}},
+    {cl100k, "Straße ÆØÅæøå", {"Straße", " ÆØÅæøå"}},
+    {cl100k, "ｆｕｌｌＷＩＤＴＨ", {"ｆｕｌｌＷＩＤＴＨ"}},
+    {cl100k, "ა ქართულიᲐᲑ", {"ა", " ქართულიᲐᲑ"}},
+    {cl100k, "Ⅻ½²", {"Ⅻ½²"}},
+    {cl100k, "  trailing  ", {" ", " trailing", "  "}},
+    {cl100k, "line\n\n  next \n", {"line", "\n\n", " ", " next", " \n"}},
+    {cl100k, "path/to/file\n", {"path", "/to", "/file", "\n"}},
+};
+
+std::string quoted(const std::vector<std::string>& pieces) {
+    std::string result;
+    for (const auto& piece : pieces) {
+        result += (result.empty() ? "" : ", ") + json(piece).dump();
+    }
+    return "[" + result + "]";
+}
+
+}
+
+int main() {
+    size_t failed = 0;
+    for (const auto& test : cases) {
+        std::vector<std::string> pieces;
+        for (auto piece : Tokenizer::split(test.text, test.encoding)) {
+            pieces.emplace_back(piece);
+        }
+        if (pieces != test.pieces) {
+            ++failed;
+            fmt::print("{} {}: expected {}, got {}\n", test.encoding == o200k ? "o200k_base" : "cl100k_base",
+                json(test.text).dump(), quoted(test.pieces), quoted(pieces));
+        }
+    }
+    fmt::print("tokenizer_test: {} of {} splits match\n", std::size(cases) - failed, std::size(cases));
+    return failed == 0 ? 0 : 1;
+}